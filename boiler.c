@@ -10,6 +10,13 @@
 #define PIN_BUTTON_READ PINB
 #define PIN_BUTTON_DDR  DDRB
 #define PIN_BUTTON_PORT PORTB
+#define PIN_BUTTON_MASK                                                       \
+  ((1 << PIN_BUTTON_DOWN) | (1 << PIN_BUTTON_MENU) | (1 << PIN_BUTTON_UP))
+
+// Кнопки меню
+#define MENU_KEY_UP    (1 << PIN_BUTTON_UP)
+#define MENU_KEY_DOWN  (1 << PIN_BUTTON_DOWN)
+#define MENU_KEY_ENTER (1 << PIN_BUTTON_MENU)
 
 // Пины для индикации
 #define PIN_LED_STOP     PC0
@@ -32,34 +39,21 @@
 #define PIN_FAN_DDR  DDRB
 #define PIN_FAN_PORT PORTB
 
-// Массив значениий для семисегментного индикатора
-static char display_segment_numbers[12] = {
-  0b11111100, // 0
-  0b01100000, // 1
-  0b11011010, // 2
-  0b11110010, // 3
-  0b01100110, // 4
-  0b10110110, // 5
-  0b10111110, // 6
-  0b11100000, // 7
-  0b11111110, // 8
-  0b11110110, // 9
-  0b00000010, // -
-  0b00000000, // пусто
-};
-
-static char display_segment_menu[10][2] = {
-  { 0b10011100, 0b11001111 }, // CP
-  { 0b11001110, 0b11001111 }, // PP
-  { 0b11111100, 0b00111111 }, // Ob
-  { 0b11111100, 0b11001111 }, // OP
-  { 0b00011110, 0b11001111 }, // TP
-  { 0b01101110, 0b00001101 }, // HI
-  { 0b00011110, 0b11111101 }, // TO
-  { 0b00011110, 0b01111101 }, // TU
-  { 0b00111110, 0b01111101 }, // bU
-  { 0b01111100, 0b10001111 }, // UF
-};
+#include "buttons.h"
+#include "ee.h"
+#include "fan.h"
+#include "glyphs.h"
+#include "menu.h"
+#include "options.h"
+#include "ow.h"
+#include "pi.h"
+#include "pwm.h"
+#include "sched.h"
+#include "temp.h"
+#include "timer.h"
+#include "timing.h"
+#include "trend.h"
+#include "tune.h"
 
 typedef enum Error {
   Error_None             = 0,
@@ -74,6 +68,13 @@ typedef enum Mode {
   MODE_CONTROL,
 } Mode;
 
+// Регулирование в автоматическом режиме, настройка Co
+typedef enum Control {
+  Control_Cycles = 0, // продувка циклами CP/PP вокруг уставки
+  Control_Pi,         // ПИ-регулятор мощности вентилятора
+  Control_Tune,       // автонастройка CP, PP и HI, затем Control_Cycles
+} Control;
+
 typedef enum State {
   STATE_HOME = 0,
   STATE_MENU,
@@ -82,121 +83,179 @@ typedef enum State {
   STATE_ALARM,
 } State;
 
+// Маски кнопок в байтах модуля buttons.h
 typedef enum Button {
-  BUTTON_UP = 0,
-  BUTTON_MENU,
-  BUTTON_DOWN,
-  BUTTON_COUNT,
+  BUTTON_UP   = 1 << PIN_BUTTON_UP,
+  BUTTON_MENU = 1 << PIN_BUTTON_MENU,
+  BUTTON_DOWN = 1 << PIN_BUTTON_DOWN,
 } Button;
 
-typedef enum Parameters {
-  CP = 0,
-  PP,
-  OB,
-  OP,
-  TP,
-  HI,
-  TO,
-  TU,
-  BU,
-  UF,
-} Parameters;
+// Разрешение DS18B20, 9..12 бит. Время преобразования - от 94 до 750 мс
+#ifndef TEMP_RESOLUTION
+#define TEMP_RESOLUTION 10
+#endif
+
+#if TEMP_RESOLUTION < 9 || TEMP_RESOLUTION > 12
+#error "TEMP_RESOLUTION must be 9..12"
+#endif
+
+#define TEMP_CONFIG        (((TEMP_RESOLUTION - 9) << 5) | 0x1F)
+#define TEMP_CONVERSION_MS (750U >> (12 - TEMP_RESOLUTION))
+// Младшие биты регистра температуры не определены при разрешении ниже 12
+#define TEMP_MASK ((Temp) ~((1 << (12 - TEMP_RESOLUTION)) - 1))
+
+// Датчиков DS18B20 на шине. Номера присваиваются в порядке кодов ПЗУ,
+// регулирование идёт по датчику 0
+#ifndef TEMP_SENSORS_MAX
+#define TEMP_SENSORS_MAX 3
+#endif
+
+#define DS18B20_FAMILY 0x28
+
+// Повторных чтений ОЗУ датчика при ошибке CRC, без нового преобразования
+#define TEMP_REREADS 2
+
+// Расширенные из-за ошибок CRC задержки слотов пишутся в журнал не чаще
+// раза за этот срок
+#define TEMP_TIMING_SAVE_PERIOD MINUTES(60)
+
+// Датчик 0 считается потерянным, если столько времени нет верного чтения.
+// Не больше 32 с: таймер считает в тиках
+#ifndef TEMP_LOST_TIMEOUT
+#define TEMP_LOST_TIMEOUT SECONDS(5)
+#endif
+
+// Упреждение по тренду, мин: при нагреве вентилятор переходит на продувку,
+// а при остывании начинается отсчёт отключения по низкой температуре, когда
+// до порога остаётся столько минут при текущем наклоне
+#define TEMP_LOOKAHEAD_MIN 2
 
 typedef enum Temp_Step {
+  Temp_Step_Search = 0,
+  Temp_Step_Calibrating,
+  Temp_Step_Searching,
+  Temp_Step_Configure,
+  Temp_Step_Configuring,
   Temp_Step_Convert,
+  Temp_Step_Converting,
   Temp_Step_Read,
+  Temp_Step_Reading,
   Temp_Step_Done,
 } Temp_Step;
 
 typedef struct Temp_Ctx {
-  // u32 temp_point; // Переменная для дробного значения температуры
-  u32       last_temp, temp;
+  Temp      last_temp, temp; // Q12.4, датчик 0
   Temp_Step step;
-  Timer32   timer;
+  bool      reconfigure;
+
+  u8   sensors, current; // найдено датчиков, читаемый датчик
+  u8   valid;            // маска датчиков с верным последним чтением
+  u8   roms[TEMP_SENSORS_MAX][OW_ROM_SIZE];
+  Temp temps[TEMP_SENSORS_MAX];
+  u8   rereads;
+  bool timing_relaxed; // задержки расширены и ещё не записаны
+
+  // Состояние шины по импульсам присутствия и CRC рабочих транзакций
+  u16 presence_errors;
+  u16 crc_errors;
 } Temp_Ctx;
 
-typedef struct Option {
-  u8 value, min, max;
-} Option;
-
-#define OPTIONS_MAX 10
-
-// Структура для хранения параметров меню
-typedef union Options {
-  struct {
-    Option fan_work_duration;  // CP - ПРОДУВКА РАБОТА (Сек.)
-    Option fan_pause_duration; // PP - ПРОДУВКА ПЕРЕРЫВ (Мин.)
-    Option fan_speed; // Ob - СКОРОСТЬ ОБОРОТОВ ВЕНТИЛЯТОРА
-    Option fan_power_during_ventilation; // OP - ОБОРОТЫ ВЕНТИЛЯТОРА ВО ВРЕМЯ
-                                         // ПРОДУВКИ
-    Option pump_connection_temperature; // ТЕМПЕРАТУРА ПОДКЛЮЧЕНИЯ НАСОСА ЦО
-    Option hysteresis;          // HI - ГИСТЕРЕЗИС
-    Option fan_power_reduction; // tO – УМЕНЬШЕНИЕ СИЛЫ ПРОДУВКИ
-    Option controller_shutdown_temperature; // tU – ТЕМПЕРАТУРА ОТКЛЮЧЕНИЯ
-                                            // КОНТРОЛЛЕРА
-    Option
-        sound_signal_enabled; // bU – ВКЛЮЧЕНИЕ И ОТКЛЮЧЕНИЕ ЗВУКОВОГО СИГНАЛА
-    Option factory_settings;  // Uf – ЗАВОДСКИЕ НАСТРОЙКИ
-  };
+// Кадр индикатора: готовые значения PORTD для двух разрядов
+typedef struct Display_Frame {
+  u8   digits[2]; // десятки (PB3), единицы (PB2)
+  bool enabled;
+} Display_Frame;
+
+// Что показано в кадре. Кадр перерисовывается только при изменении ключа
+typedef struct Display_Key {
+  u8   state;
+  i16  value;
+  bool enabled;
+  bool error; // value - код ошибки, а не число
+} Display_Key;
 
-  Option e[OPTIONS_MAX];
-} Options; // 10-bytes
+// Половина периода, с которым при тревоге по температуре код ошибки
+// сменяется температурой: 1024 тика, чтобы обойтись без деления
+#define DISPLAY_ALARM_SHIFT 10
 
 // Глобальные переменные
 static bool display_enable = true;
 
-static u8   menu_idx               = CP;
+// Двойной буфер: прерывание выводит display_frames[display_front], главный
+// цикл рисует в другой кадр и переключает индекс одной записью байта
+static Display_Frame display_frames[2];
+static volatile u8   display_front;
+
 static bool timer_out_menu_enabled = false;
 
 static Error   error_flags = Error_None;
 static Mode    mode        = MODE_STOP;
 static State   last_state, state = STATE_HOME;
-static Options options;
-static Option  option_temp_target;
+
+// Автоповтор: пункты листаются ровно, значения ускоряются до 50 в секунду
+static const Menu_Repeat menu_repeat_list PROGMEM = {
+  .delay = 500, .period = 150, .fast_after = UINT16_MAX, .fast_period = 150
+};
+static const Menu_Repeat menu_repeat_value PROGMEM = {
+  .delay = 500, .period = 100, .fast_after = 1500, .fast_period = 20
+};
+
+// Узлы меню по состояниям. Удержание и отпускание MENU на главном экране и
+// тревога обрабатываются в handle_buttons()
+static const Menu_Node menu_nodes[] PROGMEM = {
+  [STATE_HOME] = {
+    .option   = Option_temp_target,
+    .repeat   = &menu_repeat_value,
+    .on_enter = MENU_STAY,
+    .on_edit  = STATE_MENU_TEMP_CHANGE,
+  },
+  [STATE_MENU] = {
+    .option   = MENU_NONE,
+    .repeat   = &menu_repeat_list,
+    .on_enter = STATE_MENU_PARAMETERS,
+    .on_edit  = MENU_STAY,
+    .flags    = MENU_LIST | MENU_TIMEOUT,
+  },
+  [STATE_MENU_TEMP_CHANGE] = {
+    .option   = Option_temp_target,
+    .repeat   = &menu_repeat_value,
+    .on_enter = STATE_HOME,
+    .on_edit  = MENU_STAY,
+    .flags    = MENU_SAVE | MENU_TIMEOUT,
+  },
+  [STATE_MENU_PARAMETERS] = {
+    .option   = MENU_NONE,
+    .repeat   = &menu_repeat_value,
+    .on_enter = STATE_MENU,
+    .on_edit  = MENU_STAY,
+    .flags    = MENU_ITEM,
+  },
+  [STATE_ALARM] = {
+    .option   = MENU_NONE,
+    .on_enter = MENU_STAY,
+    .on_edit  = MENU_STAY,
+  },
+};
 
 // Temp
 static Temp_Ctx temp_ctx;
 
-static u8 buttons[BUTTON_COUNT];
-static u8 last_buttons[BUTTON_COUNT];
-
 // Прототипы функций
 static void init_io(void);
 static bool get_temp(Temp_Ctx *self);
-static void display_menu(u8 display1, u8 display2);
+static void display_render(void);
+static void display_scan(void);
 static void handle_buttons(void);
 static void start_alarm(void);
 static void stop_alarm(void);
 
-static inline void
-change_state(u8 new_state)
-{
-  last_state = state;
-  state      = new_state;
-}
-
-static inline void
-restore_last_state(void)
-{
-  state = last_state;
-}
-
 static void options_default(void);
-static void options_change_params(i8 value);
 static void options_save(void);
 static void options_load(void);
 
-static u8 button_pressed(u8 code);
-static u8 button_released(u8 code);
-static u8 button_down(u8 code);
-
-static u8   ow_reset(void);
-static u8   ow_read(void);
-static u8   ow_read_bit(void);
-static void ow_send_bit(u8 bit);
-static void ow_send(u8 data);
-static bool ow_skip(void);
-static u8   ow_crc_update(u8 crc, u8 byte);
+static inline u8 button_down(u8 code);
+static inline u8 button_short(u8 code);
+static inline u8 button_long(u8 code);
 
 #define LEDS_MAX 6
 
@@ -216,77 +275,97 @@ static void leds_display(Leds led);
 static void leds_change(Leds led, bool enable);
 static void leds_off(void);
 
-static Timer32 timer_cp;
-static Timer32 timer_pp;
-static Timer32 timer_controller_shutdown_temperature;
-static Timer32 timer_menu;
-static Timer32 timer_temp_alarm;
-static Timer32 timer_ow_alarm;
-static Timer32 timer_in_menu;
-static Timer32 timer_out_menu;
+// Работа вентилятора до 95 с, пауза и отключение по низкой температуре -
+// минуты, запись задержек 1-Wire - час, эти сроки не помещаются в 16 бит
+// тиков
+static Timer   timer_cp = TIMER_UNIT(Timer_Unit_10ms);
+static Timer   timer_pp = TIMER_UNIT(Timer_Unit_Second);
+static Timer   timer_controller_shutdown_temperature
+    = TIMER_UNIT(Timer_Unit_Second);
+static Timer   timer_timing_save = TIMER_UNIT(Timer_Unit_Second);
+static Timer   timer_menu;
+static Timer   timer_temp_alarm;
+static Timer   timer_temp_lost;
+static Timer   timer_trend;
+static Timer   timer_out_menu;
 
-static inline void menu_button(u8 code, i8 value);
-static inline void menu_parameters_button(u8 code, i8 value);
-static inline void menu_change_temp_button(u8 code, i8 value);
+static inline void
+change_state(u8 new_state)
+{
+  // Выход из правки уставки в фазе мигания, когда индикатор погашен, не
+  // должен оставлять его тёмным
+  if (state == STATE_MENU_TEMP_CHANGE && new_state != STATE_MENU_TEMP_CHANGE) {
+    timer_stop(&timer_menu);
+    display_enable = true;
+  }
+
+  last_state = state;
+  state      = new_state;
+}
+
+static inline void
+restore_last_state(void)
+{
+  state = last_state;
+}
+
+// Задачи главного цикла
+static void task_buttons(void);
+static void task_temp(void);
+static void task_control(void);
+static void task_leds(void);
+static void task_display(void);
+
+static u8 task_control_id;
+static u8 task_temp_id;
+
+// ПИ-регулятор и признак нового значения температуры для него. Время
+// pi_update() в отсчётах SCHED_CLOCK - для проверки бюджета на целевой плате
+static Pi   control_pi;
+static bool control_sample;
+static u16  control_pi_worst;
+static Tune control_tune;
 
 // System
 
 static inline void
 system_tick_init(void)
 {
-  // Настройка таймера 0 для глобального таймера с периодом прерывания в 1 мс
+  // Таймер 0: переполнение раз в TIMING_TIMER0_OVF_US - часы планировщика и
+  // обновление индикатора
   {
-#if 1
-    // Set prescaler to 1024
-    // Timer Overflow Period = Prescaler Value * (1 / CPU Frequency)
-    // Prescaler Value = Timer Overflow Period * CPU Frequency
-    // Since Timer0 is an 8-bit timer and has prescaler options of 1, 8, 64,
-    // 256, or 1024, the closest prescaler value that makes the timer overflow
-    // every 1ms is 1024.
-
-    // Set prescaler to 1024
-    TCCR0 |= (1 << CS01);
+    TCCR0 = TIMING_TIMER0_CS;
 
     // Enable overflow interrupt
     TIMSK |= (1 << TOIE0);
-#endif
   }
 
-  // Настройка таймера 1 для ШИМ
+  // Таймер 1 - ШИМ вентилятора, скважность ведёт fan_step()
   {
-#if 1
-    // Настройка таймера 1 в режиме Fast PWM, TOP = 0xFF
-    TCCR1A |= (1 << WGM10);
-    TCCR1B |= (1 << WGM12) | (1 << CS11); // Предделитель = 8
-
-    // Установка начального значения для регистра сравнения (скважность)
-    OCR1A = 255;
+    pwm_init();
 
     gpio_set_mode_output(&PIN_FAN_DDR, PIN_FAN);
-#endif
   }
 
-  // Настройка таймера 2 для глобального таймера с периодом прерывания в 1 мс
+  // Таймер 2 в режиме CTC: системный тик 1 мс
   {
-    // Настройка предделителя и запуск таймера
-    TCCR2 = (1 << WGM21) | (1 << CS22) | (1 << CS21)
-            | (1 << CS20); // Prescaler 1024
+    OCR2  = TIMING_TIMER2_OCR;
+    TCCR2 = (1 << WGM21) | TIMING_TIMER2_CS;
     TIMSK |= (1 << OCIE2);
-    OCR2 = 0; // 1ms for 1MHz clock
   }
 
   enable_interrupts();
 }
 
+// Включение вентилятора с мощностью power, %. Разгон плавный, см. fan.h
 static inline void
-fan_start(void)
+fan_start(u8 power)
 {
   leds_change(Leds_Control, false);
   leds_change(Leds_Rastopka, true);
   leds_change(Leds_Fan, true);
 
-  // Включение ШИМ
-  TCCR1A |= (1 << COM1A1);
+  fan_set(power);
 }
 
 static inline void
@@ -294,12 +373,26 @@ fan_stop(void)
 {
   leds_change(Leds_Fan, false);
 
-  // Выключение ШИМ
-  TCCR1A &= ~(1 << COM1A1);
+  fan_off();
 }
 
-int
-main(void)
+// Мощность розжига возле уставки: Ob, уменьшенная на tO ступеней по 5%, но
+// не ниже минимума настройки Ob
+static inline u8
+fan_reduced_power(void)
+{
+  u8 reduction = options.fan_power_reduction * 5;
+  u8 floor     = option_min(Option_fan_speed);
+
+  if (options.fan_speed < floor + reduction) {
+    return floor;
+  }
+
+  return options.fan_speed - reduction;
+}
+
+static void
+boiler_init(void)
 {
 #if 0
   u16 i;
@@ -310,7 +403,7 @@ main(void)
   options_default();
   options_save();
 
-  return 0;
+  return;
 #endif
   system_tick_init();
 
@@ -320,216 +413,333 @@ main(void)
   options_default();
   options_load();
 
-  do {
-    static u8 rep = 0;
-    if (!ow_reset()) {
-      if (timer_expired_ext(&timer_ow_alarm, SECONDS(1), 0, 0, s_ticks)) {
-        if (rep >= 5) {
-          rep = 0;
-          if (!ow_reset()) {
-            error_flags = Error_Temp_Sensor;
-            start_alarm();
-            timer_reset(&timer_ow_alarm);
-          }
-        }
-        rep -= 1;
-      }
-    } else {
-      rep = 0;
-      timer_reset(&timer_ow_alarm);
+  sched_add(task_buttons, 5, 0);
+  task_control_id = sched_add(task_control, 100, 1);
+  task_temp_id    = sched_add(task_temp, 10, 2);
+  sched_add(task_leds, SECONDS(1), 4);
+  sched_add(task_display, 10, 1);
+}
+
+// Кнопки, меню и индикация режима
+static void
+task_buttons(void)
+{
+  handle_buttons();
+
+  if (timer_out_menu_enabled
+      && timer_once(&timer_out_menu, SECONDS(5), get_ticks())
+      && state != STATE_HOME) {
+    change_state(STATE_HOME);
+    if (last_state == STATE_MENU_TEMP_CHANGE
+        || last_state == STATE_MENU_PARAMETERS || last_state == STATE_MENU) {
+      last_state = STATE_HOME;
     }
 
-  } while (timer_expired_ext(&timer_ow_alarm, 0, SECONDS(1), 0, s_ticks));
+    timer_out_menu_enabled = false;
+    timer_stop(&timer_out_menu);
 
-  timer_reset(&timer_ow_alarm);
+    options_save();
+  }
 
-  for (;;) {
-    if (timer_expired_ext(&timer_ow_alarm, 0, 0, SECONDS(1), s_ticks)) {
-      static u8 rep = 0;
-      if (!ow_reset() && state != STATE_ALARM) {
-        if (rep >= 5) {
-          rep = 0;
-          if (!ow_reset()) {
-            error_flags = Error_Temp_Sensor;
-            start_alarm();
-            timer_reset(&timer_ow_alarm);
-          }
-        }
-        rep -= 1;
-      } else {
-        rep = 0;
-        timer_reset(&timer_ow_alarm);
+  if (state == STATE_HOME && last_state == STATE_ALARM) {
+    stop_alarm();
+  }
+
+  if (state != STATE_ALARM) {
+    if (state == STATE_MENU_TEMP_CHANGE) {
+      if (timer_every(&timer_menu, 250, get_ticks())) {
+        display_enable ^= 1;
       }
     }
 
-    handle_buttons();
+    if (state == STATE_HOME) {
+      if (options.factory_settings == 1) {
+        options_default();
 
-    if (timer_out_menu_enabled
-        && timer_expired_ext(&timer_out_menu, SECONDS(5), 0, 0, s_ticks)
-        && state != STATE_HOME) {
-      change_state(STATE_HOME);
-      if (last_state == STATE_MENU_TEMP_CHANGE
-          || last_state == STATE_MENU_PARAMETERS || last_state == STATE_MENU) {
-        last_state = STATE_HOME;
+        options_save();
       }
+    }
+  }
+}
 
-      timer_out_menu_enabled = false;
-      timer_reset(&timer_out_menu);
+static void
+task_temp(void)
+{
+  if (get_temp(&temp_ctx)) {
+    timer_stop(&timer_temp_lost);
+    trend_sample(temp_ctx.temp);
+    control_sample = true;
+    sched_signal(task_control_id);
+  }
 
-      display_enable = false;
-      gpio_write_low(&PORTB, PB3);
-      gpio_write_low(&PORTB, PB2);
-      options_save();
-      display_enable = true;
+  // Удачная транзакция завершена - следующий шаг опроса начнётся на
+  // ближайшем проходе, а не через период задачи. После ошибки повтор - через
+  // период: шину без датчика незачем сбрасывать каждый тик
+  if (!ow_busy() && ow_result() == Ow_Result_Ok) {
+    sched_signal(task_temp_id);
+  }
 
-      // PWM
-      {
-        OCR1A = (options.fan_speed.value - 0) * (255 - 0) / (99 - 0) + 0;
-      }
-    }
+  if (timer_every(&timer_trend, TREND_PERIOD, get_ticks())) {
+    trend_tick();
+  }
 
-    get_temp(&temp_ctx);
+  // Каждое сохранение - новая запись журнала, и сбойная шина изнашивала бы
+  // EEPROM
+  if (temp_ctx.timing_relaxed
+      && timer_once(&timer_timing_save, TEMP_TIMING_SAVE_PERIOD, get_ticks())) {
+    timer_stop(&timer_timing_save);
+    temp_ctx.timing_relaxed = false;
+    options_save();
+  }
 
-#if 1
-    if (state == STATE_ALARM) {
-      if (options.sound_signal_enabled.value) {
-        // ...
-      }
+  // Отдельной проверки присутствия нет: датчик потерян, если транзакции
+  // опроса долго не дают верного чтения
+  if (timer_once(&timer_temp_lost, TEMP_LOST_TIMEOUT, get_ticks())) {
+    timer_stop(&timer_temp_lost);
+    if (state != STATE_ALARM) {
+      error_flags = Error_Temp_Sensor;
+      start_alarm();
     }
+  }
+}
 
-    if (state == STATE_HOME && last_state == STATE_ALARM) {
-      stop_alarm();
+// Сброс регуляторов при выходе из их режима
+static void
+control_reset(void)
+{
+  pi_reset(&control_pi);
+  control_tune.phase = Tune_Phase_Idle;
+}
+
+// Автонастройка: релейный опыт вокруг уставки. По окончании, удачном или
+// нет, регулирование возвращается к циклам CP/PP
+static void
+control_tune_step(void)
+{
+  bool heat = false;
+
+  timer_stop(&timer_cp);
+  timer_stop(&timer_pp);
+  pi_reset(&control_pi);
+
+  if (control_tune.phase == Tune_Phase_Idle) {
+    tune_start(&control_tune, get_ticks());
+  }
+
+  if (!control_sample) {
+    return;
+  }
+  control_sample = false;
+
+  heat = tune_update(&control_tune, temp_ctx.temp,
+                     TEMP(options.temp_target), get_ticks());
+
+  if (!tune_running(&control_tune)) {
+    control_tune.phase   = Tune_Phase_Idle;
+    options.control_mode = Control_Cycles;
+    options_save();
+    fan_stop();
+    return;
+  }
+
+  if (heat) {
+    mode = MODE_RASTOPKA;
+    fan_start(options.fan_speed);
+  } else {
+    mode = MODE_CONTROL;
+    leds_change(Leds_Control, true);
+    leds_change(Leds_Rastopka, false);
+    fan_stop();
+  }
+}
+
+// ПИ-регулирование: скважность пересчитывается на каждое новое значение
+// температуры и не превышает мощности Ob, между значениями она не меняется
+static void
+control_pi_step(void)
+{
+  u16 start = 0, elapsed = 0, duty = 0;
+
+  mode = MODE_CONTROL;
+  leds_change(Leds_Control, true);
+  leds_change(Leds_Rastopka, false);
+
+  timer_stop(&timer_cp);
+  timer_stop(&timer_pp);
+
+  if (!control_sample) {
+    return;
+  }
+  control_sample = false;
+
+  start   = SCHED_CLOCK();
+  duty    = pi_update(&control_pi, TEMP(options.temp_target) - temp_ctx.temp,
+                      fan_power_permille(options.fan_speed), get_ticks());
+  elapsed = SCHED_CLOCK() - start;
+
+  if (elapsed > control_pi_worst) {
+    control_pi_worst = elapsed;
+  }
+
+  leds_change(Leds_Fan, duty != 0);
+  fan_set_permille(duty);
+}
+
+// Аварии и алгоритм работы вентилятора. Запускается на каждое новое
+// значение температуры и по периоду, чтобы отрабатывать циклы CP/PP
+static void
+task_control(void)
+{
+  Temp cold = 0, hot = 0;
+
+  if (state == STATE_ALARM) {
+    if (options.sound_signal_enabled) {
+      // ...
     }
+    return;
+  }
 
-    if (state != STATE_ALARM) {
-      if (state == STATE_MENU_TEMP_CHANGE) {
-        if (timer_expired_ext(&timer_menu, 0, 0, 250, s_ticks)) {
-          display_enable ^= 1;
-        }
+  if (mode != MODE_STOP) {
+    leds_change(Leds_Stop, false);
+
+    if (temp_ctx.temp > TEMP(90)) {
+      if (timer_once(&timer_temp_alarm, SECONDS(5), get_ticks())) {
+        error_flags = Error_High_Temperature;
+        start_alarm();
+        timer_stop(&timer_temp_alarm);
+        return;
       }
+    } else if (temp_ctx.temp < TEMP(90)) {
+      timer_stop(&timer_temp_alarm);
+    }
 
-      if (state == STATE_HOME) {
-        if (options.factory_settings.value == 1) {
-          options_default();
+    // При остывании отсчёт отключения начинается заранее, по прогнозу
+    cold = temp_trend() < 0 ? temp_forecast(temp_ctx.temp, TEMP_LOOKAHEAD_MIN)
+                            : temp_ctx.temp;
+
+    if (TEMP(options.controller_shutdown_temperature) > cold) {
+      if (timer_once(&timer_controller_shutdown_temperature, MINUTES(5),
+                     get_ticks())) {
+        error_flags = Error_Low_Temperature;
+        start_alarm();
+        timer_stop(&timer_controller_shutdown_temperature);
+        return;
+      }
+    }
 
-          display_enable = false;
-          gpio_write_low(&PORTB, PB3);
-          gpio_write_low(&PORTB, PB2);
-          options_save();
-          display_enable = true;
+    if (TEMP(options.controller_shutdown_temperature) < cold) {
+      timer_stop(&timer_controller_shutdown_temperature);
+    }
 
-          // PWM
-          {
-            OCR1A = (options.fan_speed.value - 0) * (255 - 0) / (99 - 0) + 0;
-          }
-        }
-      }
+    // Алгоритм работы
+    if (temp_ctx.temp < TEMP(35)) {
+      // Вентилятор начнет работу в ручном режиме.
+      mode = MODE_RASTOPKA;
 
-      if (mode != MODE_STOP) {
-        leds_change(Leds_Stop, false);
+      fan_start(options.fan_speed);
 
-        if (temp_ctx.temp > 90) {
-          if (timer_expired_ext(&timer_temp_alarm, SECONDS(5), 0, 0,
-                                s_ticks)) {
-            error_flags = Error_High_Temperature;
-            start_alarm();
-            timer_reset(&timer_temp_alarm);
-            continue;
-          }
-        } else if (temp_ctx.temp < 90) {
-          timer_reset(&timer_temp_alarm);
-        }
+      timer_stop(&timer_cp);
+      timer_stop(&timer_pp);
+      control_reset();
+    } else if (options.control_mode == Control_Pi) {
+      control_pi_step();
+    } else if (options.control_mode == Control_Tune) {
+      control_tune_step();
+    } else {
+      // Вентилятор начнет работу в автоматическом режиме.
+      Temp high = TEMP(options.temp_target + options.hysteresis);
+      Temp low  = TEMP(options.temp_target - options.hysteresis);
 
-        if (options.controller_shutdown_temperature.value > temp_ctx.temp) {
-          if (timer_expired_ext(&timer_controller_shutdown_temperature,
-                                MINUTES(5), 0, 0, s_ticks)) {
-            error_flags = Error_Low_Temperature;
-            start_alarm();
-            timer_reset(&timer_controller_shutdown_temperature);
-            continue;
-          }
-        }
+      control_reset();
 
-        if (options.controller_shutdown_temperature.value < temp_ctx.temp) {
-          timer_reset(&timer_controller_shutdown_temperature);
-        }
+      // При нагреве вентилятор переходит на продувку заранее, чтобы инерция
+      // котла не проносила температуру выше уставки
+      hot = temp_trend() > 0 ? temp_forecast(temp_ctx.temp, TEMP_LOOKAHEAD_MIN)
+                             : temp_ctx.temp;
 
-        // Алгоритм работы
-        if (temp_ctx.temp < 35) {
-          // Вентилятор начнет работу в ручном режиме.
-          mode = MODE_RASTOPKA;
+      if (hot >= high) {
+        mode = MODE_CONTROL;
+        leds_change(Leds_Control, true);
+        leds_change(Leds_Rastopka, false);
 
-          fan_start();
+        if (!timer_wait_done(&timer_pp) && timer_wait_done(&timer_cp)) {
+          timer_stop(&timer_cp);
+        }
 
-          timer_reset(&timer_cp);
-          timer_reset(&timer_pp);
-        } else {
-          // Вентилятор начнет работу в автоматическом режиме.
-          if (temp_ctx.temp
-              >= option_temp_target.value + options.hysteresis.value) {
-            mode = MODE_CONTROL;
-            leds_change(Leds_Control, true);
-            leds_change(Leds_Rastopka, false);
-
-            if (!timer_pp.wait_done && timer_cp.wait_done) {
-              timer_reset(&timer_cp);
-            }
-
-            if (timer_expired_ext(
-                    &timer_pp, MINUTES(options.fan_pause_duration.value),
-                    MINUTES(options.fan_pause_duration.value),
-                    MINUTES(options.fan_pause_duration.value), s_ticks)) {
-              if (timer_expired_ext(
-                      &timer_cp, 0, SECONDS(options.fan_work_duration.value),
-                      SECONDS(options.fan_work_duration.value), s_ticks)) {
-                fan_start();
-              } else {
-                fan_stop();
-              }
-            } else {
-              fan_stop();
-            }
-          } else if (temp_ctx.temp
-                     <= option_temp_target.value - options.hysteresis.value) {
-            mode = MODE_RASTOPKA;
-            leds_change(Leds_Rastopka, true);
-            leds_change(Leds_Control, false);
-
-            if (timer_pp.wait_done) {
-              timer_reset(&timer_cp);
-              timer_reset(&timer_pp);
-            }
-
-            if (timer_expired_ext(
-                    &timer_cp, 0, SECONDS(options.fan_work_duration.value),
-                    SECONDS(options.fan_work_duration.value), s_ticks)) {
-              fan_start();
-            } else {
-              fan_stop();
-            }
+        if (timer_duty(
+                &timer_pp, MINUTES(options.fan_pause_duration),
+                MINUTES(options.fan_pause_duration),
+                MINUTES(options.fan_pause_duration), get_ticks())) {
+          if (timer_duty(
+                  &timer_cp, 0, SECONDS(options.fan_work_duration),
+                  SECONDS(options.fan_work_duration), get_ticks())) {
+            // Продувка с мощностью OP
+            fan_start(options.fan_power_during_ventilation);
+          } else {
+            fan_stop();
           }
+        } else {
+          fan_stop();
+        }
+      } else if (temp_ctx.temp <= low || mode == MODE_RASTOPKA) {
+        // Ниже уставки розжиг идёт с мощностью Ob, в зоне гистерезиса на
+        // подходе к уставке - с мощностью, уменьшенной на tO
+        u8 power = temp_ctx.temp <= low ? options.fan_speed
+                                        : fan_reduced_power();
+
+        mode = MODE_RASTOPKA;
+        leds_change(Leds_Rastopka, true);
+        leds_change(Leds_Control, false);
+
+        if (timer_wait_done(&timer_pp)) {
+          timer_stop(&timer_cp);
+          timer_stop(&timer_pp);
         }
 
-        if (temp_ctx.temp >= options.pump_connection_temperature.value) {
-          leds_change(Leds_Pump, true);
+        if (timer_duty(
+                &timer_cp, 0, SECONDS(options.fan_work_duration),
+                SECONDS(options.fan_work_duration), get_ticks())) {
+          fan_start(power);
         } else {
-          leds_change(Leds_Pump, false);
+          fan_stop();
         }
       }
     }
-#endif
 
-    {
-      static Timer32 timer;
-      if (timer_expired_ext(&timer, 0, 0, SECONDS(1), s_ticks)) {
-        leds_display(Leds_Stop);
-        leds_display(Leds_Rastopka);
-        leds_display(Leds_Control);
-        leds_display(Leds_Alarm);
-        leds_display(Leds_Pump);
-        leds_display(Leds_Fan);
-      }
+    if (temp_ctx.temp >= TEMP(options.pump_connection_temperature)) {
+      leds_change(Leds_Pump, true);
+    } else {
+      leds_change(Leds_Pump, false);
     }
+  } else {
+    control_reset();
+  }
+}
+
+static void
+task_display(void)
+{
+  display_render();
+}
+
+static void
+task_leds(void)
+{
+  leds_display(Leds_Stop);
+  leds_display(Leds_Rastopka);
+  leds_display(Leds_Control);
+  leds_display(Leds_Alarm);
+  leds_display(Leds_Pump);
+  leds_display(Leds_Fan);
+}
+
+int
+main(void)
+{
+  boiler_init();
+
+  for (;;) {
+    sched_run(get_ticks());
   }
 
   return 0;
@@ -562,9 +772,67 @@ init_io(void)
   gpio_set_mode_output(&DDRD, PD7);
 }
 
+// Забыть найденные датчики и перечислить их заново
+static void
+temp_restart(Temp_Ctx *self)
+{
+  self->sensors = 0;
+  self->valid   = 0;
+  self->step    = Temp_Step_Search;
+  ow_search_reset();
+}
+
+// Вместо ОЗУ датчика прочитаны одни единицы или одни нули: датчик не
+// ответил, например пропал с шины, а отозвались на сброс остальные
+static bool
+temp_scratchpad_blank(void)
+{
+  u8 first = ow_data(0);
+  u8 i     = 0;
+
+  if (first != 0x00 && first != 0xFF) {
+    return false;
+  }
+
+  for (i = 1; i < 9; i++) {
+    if (ow_data(i) != first) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// Ошибка транзакции: учесть её и перечислить датчики на шине заново
+static void
+temp_rescan(Temp_Ctx *self)
+{
+  if (ow_result() == Ow_Result_No_Presence) {
+    self->presence_errors += 1;
+  }
+
+  temp_restart(self);
+}
+
+// Опрос датчиков. При запуске датчики находятся поиском ПЗУ, затем по кругу:
+// одно общее преобразование через Skip ROM для всех датчиков и чтение каждого
+// через Match ROM, а единственного - через Skip ROM. Возвращает true, когда
+// прочитан датчик 0
 bool
 get_temp(Temp_Ctx *self)
 {
+  static const u8 cmd_config[] = {
+    OW_CMD_SKIP_ROM, // Всем датчикам
+    0x4E,            // Запись ОЗУ: TH, TL, регистр конфигурации
+    0x4B,
+    0x46,
+    TEMP_CONFIG,
+  };
+  static const u8 cmd_convert[] = {
+    OW_CMD_SKIP_ROM, // Всем датчикам
+    0x44,            // Запуск температурного преобразования
+  };
+
   bool res = false;
 
   self->last_temp = self->temp;
@@ -572,42 +840,185 @@ get_temp(Temp_Ctx *self)
   self->step = self->step == Temp_Step_Done ? Temp_Step_Convert : self->step;
 
   switch (self->step) {
-  case Temp_Step_Convert: {
-    if (ow_reset()) {
-      ow_send(0xCC); // Проверка кода датчика
-      ow_send(0x44); // Запуск температурного преобразования
+  case Temp_Step_Search: {
+    if (!ow_timing.calibrated) {
+      if (ow_begin_calibrate()) {
+        self->step = Temp_Step_Calibrating;
+      }
+    } else if (ow_begin_search()) {
+      self->step = Temp_Step_Searching;
+    }
+  } break;
 
-      timer_reset(&self->timer);
-      self->step = Temp_Step_Read;
+  case Temp_Step_Calibrating: {
+    if (ow_busy()) {
+      break;
     }
+
+    if (ow_result() != Ow_Result_Ok) {
+      temp_rescan(self);
+      break;
+    }
+
+    // Подобранные задержки сохраняются вместе с настройками. Поиск - с
+    // начала: сброс мог застать на шине чужую транзакцию
+    options_save();
+    temp_restart(self);
   } break;
 
+  case Temp_Step_Searching: {
+    u8 rom[OW_ROM_SIZE];
+    u8 i = 0;
+
+    if (ow_busy()) {
+      break;
+    }
+
+    if (ow_result() != Ow_Result_Ok) {
+      temp_rescan(self);
+      break;
+    }
+
+    for (i = 0; i < OW_ROM_SIZE; i++) {
+      rom[i] = ow_search_rom(i);
+    }
+
+    if (crc8(rom, OW_ROM_SIZE - 1) == rom[OW_ROM_SIZE - 1]
+        && rom[0] == DS18B20_FAMILY && self->sensors < TEMP_SENSORS_MAX) {
+      memcpy(self->roms[self->sensors], rom, OW_ROM_SIZE);
+      self->sensors += 1;
+    }
+
+    if (!ow_search_done()) {
+      self->step = Temp_Step_Search;
+    } else if (self->sensors) {
+      self->step = Temp_Step_Configure;
+    } else {
+      temp_rescan(self);
+    }
+  } break;
+
+  case Temp_Step_Configure: {
+    if (ow_begin(cmd_config, sizeof(cmd_config), 0)) {
+      self->reconfigure = false;
+      self->step        = Temp_Step_Configuring;
+    }
+  } break;
+
+  case Temp_Step_Configuring: {
+    if (ow_busy()) {
+      break;
+    }
+
+    if (ow_result() == Ow_Result_Ok) {
+      self->step = Temp_Step_Convert;
+    } else {
+      temp_rescan(self);
+    }
+  } break;
+
+  case Temp_Step_Convert: {
+    // Пока идёт преобразование, датчики отвечают на слоты чтения нулём
+    if (ow_begin_poll(cmd_convert, sizeof(cmd_convert),
+                      TEMP_CONVERSION_MS + TEMP_CONVERSION_MS / 4)) {
+      self->step = Temp_Step_Converting;
+    }
+  } break;
+
+  case Temp_Step_Converting: {
+    if (ow_busy()) {
+      break;
+    }
+
+    if (ow_result() != Ow_Result_Ok) {
+      temp_rescan(self);
+      break;
+    }
+
+    self->current = 0;
+    self->rereads = 0;
+    self->step    = Temp_Step_Read;
+  }
+    // fallthrough
+
   case Temp_Step_Read: {
-    if (timer_expired_ext(&self->timer, SECONDS(1), 0, 0, s_ticks)) {
-      if (ow_reset()) {
-        u8 crc = 0;
-        u8 scratchpad[8];
-
-        ow_send(0xCC); // Проверка кода датчика
-        ow_send(0xBE); // Считываем содержимое ОЗУ
-
-        u8 i = 0;
-        for (i = 0; i < 8; i++) {
-          u8 b          = ow_read();
-          scratchpad[i] = b;
-          crc           = ow_crc_update(crc, b);
-        }
-        if (ow_read() == crc) {
-          self->temp = ((scratchpad[1] << 4) & 0x70) | (scratchpad[0] >> 4);
-          res        = true;
-        }
-#if 0
-          temp = (Temp_LSB & 0x0F);
-          temp_point = temp * 625 / 1000; // Точность
-          темпер.преобразования(0.0625)
-#endif
+    u8 cmd[OW_ROM_SIZE + 2];
+    u8 len = 0;
+
+    // Единственный датчик не нужно адресовать: на 64 слота записи меньше
+    if (self->sensors == 1) {
+      cmd[len++] = OW_CMD_SKIP_ROM;
+    } else {
+      cmd[len++] = OW_CMD_MATCH_ROM;
+      memcpy(&cmd[len], self->roms[self->current], OW_ROM_SIZE);
+      len += OW_ROM_SIZE;
+    }
+    cmd[len++] = 0xBE; // Считываем содержимое ОЗУ
+
+    if (ow_begin(cmd, len, 9)) {
+      self->step = Temp_Step_Reading;
+    }
+  } break;
+
+  case Temp_Step_Reading: {
+    u8 crc  = 0;
+    u8 i    = 0;
+    u8 mask = 1 << self->current;
+
+    if (ow_busy()) {
+      break;
+    }
+
+    if (ow_result() != Ow_Result_Ok) {
+      temp_rescan(self);
+      break;
+    }
+
+    for (i = 0; i < 8; i++) {
+      crc = crc8_update(crc, ow_data(i));
+    }
+
+    if (ow_data(8) != crc) {
+      self->crc_errors += 1;
+
+      // Помеха при чтении: результат преобразования ещё в ОЗУ датчика
+      if (self->rereads < TEMP_REREADS) {
+        self->rereads += 1;
+        self->step = Temp_Step_Read;
+        break;
       }
 
+      self->valid &= ~mask;
+
+      // Повторы не помогли - слотам не хватает запаса. Присутствие уже
+      // подтверждено результатом Ok, но запас имеет смысл расширять, только
+      // если ответил сам датчик: иначе выборка уходила бы на каждом круге
+      if (!temp_scratchpad_blank() && ow_timing_relax()) {
+        self->timing_relaxed = true;
+      }
+    } else {
+      self->temps[self->current]
+          = temp_from_scratchpad(ow_data(0), ow_data(1)) & TEMP_MASK;
+      self->valid |= mask;
+
+      // Датчик потерял настройку, например после пропадания питания
+      if (ow_data(4) != TEMP_CONFIG) {
+        self->reconfigure = true;
+      }
+
+      if (self->current == 0) {
+        self->temp = self->temps[0];
+        res        = true;
+      }
+    }
+
+    self->rereads = 0;
+
+    if (++self->current < self->sensors) {
+      self->step = Temp_Step_Read;
+    } else if (self->reconfigure) {
+      self->step = Temp_Step_Configure;
+    } else {
       self->step = Temp_Step_Done;
     }
   } break;
@@ -619,140 +1030,134 @@ get_temp(Temp_Ctx *self)
   return res;
 }
 
-void
-display_menu(u8 display1, u8 display2)
+// Номер ошибки для индикатора: E1 - датчик, E2 - низкая температура, E3 -
+// перегрев
+static inline u8
+error_code(Error flags)
 {
-  static u8 display_idx = 0;
+  u8 code = 1;
 
-  if (!display_enable) {
-    gpio_write_low(&PORTB, PB3);
-    gpio_write_low(&PORTB, PB2);
-    return;
+  while (flags > Error_Temp_Sensor) {
+    flags >>= 1;
+    code += 1;
   }
 
-  switch (display_idx) {
-  case 0:
-    gpio_write_low(&PORTB, PB3);
-    gpio_write_height(&PORTB, PB2);
-    PORTD       = ~(display2);
-    display_idx = 1;
-    break;
-  case 1:
-    gpio_write_low(&PORTB, PB2);
-    gpio_write_height(&PORTB, PB3);
-    PORTD       = ~(display1);
-    display_idx = 0;
-    break;
-  default:
-    break;
-  }
+  return code;
 }
 
+// Готовит кадр для текущего состояния. Деление на разряды выполняется
+// только когда показываемое значение изменилось
 void
-menu_button(u8 code, i8 value)
+display_render(void)
 {
-  static Timer32 timer;
-
-  if (button_pressed(code)) {
-    timer_reset(&timer_out_menu);
+  static Display_Key last = { .state = UINT8_MAX };
 
-    menu_idx
-        = CLAMP(menu_idx + value == UINT8_MAX ? 0 : menu_idx + value, 0, 9);
-  }
+  Display_Key    key = { .state = state, .enabled = display_enable };
+  Display_Frame *back;
+  u8             tens, units;
 
-  if (button_released(code)) {
-    timer_reset(&timer);
-  }
-
-  if (button_down(code)) {
-    timer_reset(&timer_out_menu);
-
-    if (timer_expired_ext(&timer, 500, 0, 50, s_ticks)) {
-      menu_idx
-          = CLAMP(menu_idx + value == UINT8_MAX ? 0 : menu_idx + value, 0, 9);
-    }
+  switch (state) {
+  case STATE_HOME:
+    key.value = temp_to_int(temp_ctx.temp);
+    break;
+  case STATE_ALARM:
+    key.error = error_flags == Error_Temp_Sensor
+                || (get_ticks() >> DISPLAY_ALARM_SHIFT) & 1;
+    key.value = key.error ? error_code(error_flags)
+                          : temp_to_int(temp_ctx.temp);
+    break;
+  case STATE_MENU_TEMP_CHANGE:
+    key.value = options.temp_target;
+    break;
+  case STATE_MENU:
+    key.value = menu_selected;
+    break;
+  case STATE_MENU_PARAMETERS:
+    key.value = options.e[menu_selected];
+    break;
+  default:
+    break;
   }
-}
 
-void
-menu_parameters_button(u8 code, i8 value)
-{
-  static Timer32 timer;
-
-  if (button_pressed(code)) {
-    timer_reset(&timer_out_menu);
-
-    options_change_params(value);
+  if (key.state == last.state && key.value == last.value
+      && key.enabled == last.enabled && key.error == last.error) {
+    return;
   }
-
-  if (button_released(code)) {
-    timer_reset(&timer);
+  last = key;
+
+  if (state == STATE_MENU) {
+    tens  = menu_item_glyph(key.value, 0);
+    units = menu_item_glyph(key.value, 1);
+  } else if (key.error) {
+    tens  = glyph_error(0, key.value);
+    units = glyph_error(1, key.value);
+  } else if (key.value <= -10) {
+    tens  = glyph(Glyph_Dash);
+    units = glyph(Glyph_Dash);
+  } else if (key.value < 0) {
+    tens  = glyph(Glyph_Dash);
+    units = glyph(-key.value);
+  } else {
+    key.value = CLAMP_TOP(key.value, 99);
+    tens      = glyph(key.value / 10);
+    units     = glyph(key.value % 10);
   }
 
-  if (button_down(code)) {
-    timer_reset(&timer_out_menu);
+  back            = &display_frames[display_front ^ 1];
+  back->digits[0] = ~tens;
+  back->digits[1] = ~units;
+  back->enabled   = key.enabled;
 
-    if (timer_expired_ext(&timer, 500, 0, 10, s_ticks)) {
-      options_change_params(value);
-    }
-  }
+  // Кадр не volatile: без барьера запись в него могла бы уйти за
+  // переключение, и прерывание показало бы недописанный кадр
+  memory_barrier();
+  display_front ^= 1;
 }
 
+// Вывод очередного разряда, вызывается из прерывания
 void
-menu_change_temp_button(u8 code, i8 value)
+display_scan(void)
 {
-  static Timer32 timer;
+  static u8 display_idx = 0;
 
-  if (button_pressed(code)) {
-    timer_reset(&timer_out_menu);
+  const Display_Frame *frame = &display_frames[display_front];
 
-    option_temp_target.value
-        = CLAMP(option_temp_target.value + value == UINT8_MAX
-                    ? 0
-                    : option_temp_target.value + value,
-                option_temp_target.min, option_temp_target.max);
-    change_state(STATE_MENU_TEMP_CHANGE);
+  if (!frame->enabled) {
+    gpio_write_low(&PORTB, PB3);
+    gpio_write_low(&PORTB, PB2);
+    return;
   }
 
-  if (button_released(code)) {
-    timer_reset(&timer);
+  if (display_idx) {
+    gpio_write_low(&PORTB, PB2);
+    gpio_write_height(&PORTB, PB3);
+    PORTD = frame->digits[0];
+  } else {
+    gpio_write_low(&PORTB, PB3);
+    gpio_write_height(&PORTB, PB2);
+    PORTD = frame->digits[1];
   }
 
-  if (button_down(code)) {
-    timer_reset(&timer_out_menu);
-
-    if (timer_expired_ext(&timer, 500, 0, 10, s_ticks)) {
-      option_temp_target.value
-          = CLAMP(option_temp_target.value + value == UINT8_MAX
-                      ? 0
-                      : option_temp_target.value + value,
-                  option_temp_target.min, option_temp_target.max);
-    }
-  }
+  display_idx ^= 1;
 }
 
 void
 handle_buttons(void)
 {
-  memcpy(&last_buttons, &buttons, sizeof(last_buttons));
+  Menu_Node node;
 
-  buttons[BUTTON_UP]   = PIN_BUTTON_READ & (1 << PIN_BUTTON_UP);
-  buttons[BUTTON_MENU] = PIN_BUTTON_READ & (1 << PIN_BUTTON_MENU);
-  buttons[BUTTON_DOWN] = PIN_BUTTON_READ & (1 << PIN_BUTTON_DOWN);
+  buttons_update();
 
   switch (state) {
   case STATE_HOME: {
-    if (button_pressed(BUTTON_MENU)) {
-      // timer_out_menu_enabled = true;
-      // timer_reset(&timer_out_menu);
-    } else if (button_down(BUTTON_MENU)) {
-      if (timer_expired_ext(&timer_in_menu, SECONDS(2), 0, 0, s_ticks)) {
-        change_state(STATE_MENU);
-        timer_reset(&timer_in_menu);
-      }
-    } else if (button_released(BUTTON_MENU)) {
-      timer_reset(&timer_in_menu);
-      timer_reset(&timer_temp_alarm);
+    if (button_long(BUTTON_MENU)) {
+      // Вход в меню удержанием, отпускание придёт уже в меню
+      change_state(STATE_MENU);
+      return;
+    }
+
+    if (button_short(BUTTON_MENU)) {
+      timer_stop(&timer_temp_alarm);
 
       if (last_state == STATE_HOME || last_state == STATE_ALARM) {
         if (mode == MODE_STOP) {
@@ -766,7 +1171,7 @@ handle_buttons(void)
           leds_change(Leds_Stop, true);
           fan_stop();
         }
-        break;
+        return;
       } else if (last_state == STATE_MENU_TEMP_CHANGE
                  || last_state == STATE_ALARM
                  || last_state == STATE_MENU_PARAMETERS
@@ -774,67 +1179,55 @@ handle_buttons(void)
         last_state = STATE_HOME;
       }
     }
-
-    menu_change_temp_button(BUTTON_UP, 1);
-    menu_change_temp_button(BUTTON_DOWN, -1);
   } break;
 
-  case STATE_MENU: {
-    timer_out_menu_enabled = true;
+  case STATE_ALARM: {
+    if (button_short(BUTTON_MENU)) {
+      stop_alarm();
 
-    if (button_pressed(BUTTON_MENU)) {
-      timer_reset(&timer_out_menu);
-      change_state(STATE_MENU_PARAMETERS);
-      break;
+      // disable sound alarm
+      {
+        // ...
+      }
     }
+    return;
+  }
 
-    menu_button(BUTTON_UP, 1);
-    menu_button(BUTTON_DOWN, -1);
-  } break;
-
-  case STATE_MENU_PARAMETERS: {
-    if (button_pressed(BUTTON_MENU)) {
-      timer_reset(&timer_out_menu);
-      change_state(STATE_MENU);
-      break;
-    }
+  default:
+    break;
+  }
 
-    menu_parameters_button(BUTTON_UP, 1);
-    menu_parameters_button(BUTTON_DOWN, -1);
-  } break;
+  menu_node(&node, menu_nodes, state);
 
-  case STATE_MENU_TEMP_CHANGE: {
+  if (node.flags & MENU_TIMEOUT) {
     timer_out_menu_enabled = true;
+  }
 
-    if (button_pressed(BUTTON_MENU)) {
-      timer_out_menu_enabled = false;
-      timer_reset(&timer_out_menu);
-      change_state(STATE_HOME);
+  // Любое нажатие откладывает выход из меню по бездействию
+  if (button_down(BUTTON_UP | BUTTON_DOWN)) {
+    timer_stop(&timer_out_menu);
+  }
 
-      display_enable = false;
-      gpio_write_low(&PORTB, PB3);
-      gpio_write_low(&PORTB, PB2);
+  switch (menu_handle(&node, get_ticks())) {
+  case Menu_Event_Enter: {
+    timer_stop(&timer_out_menu);
+    change_state(node.on_enter);
+
+    if (node.flags & MENU_SAVE) {
+      timer_out_menu_enabled = false;
       options_save();
-      display_enable = true;
-      break;
     }
-
-    menu_change_temp_button(BUTTON_UP, 1);
-    menu_change_temp_button(BUTTON_DOWN, -1);
   } break;
 
-  case STATE_ALARM: {
-    if (button_released(BUTTON_MENU)) {
-      stop_alarm();
-
-      // disable sound alarm
-      {
-        // ...
-      }
+  case Menu_Event_Edit: {
+    if (node.on_edit != MENU_STAY) {
+      change_state(node.on_edit);
     }
+  } break;
+
+  default:
     break;
   }
-  }
 }
 
 void
@@ -845,14 +1238,12 @@ start_alarm(void)
   leds_off();
   leds_change(Leds_Stop, true);
   leds_change(Leds_Alarm, true);
-  timer_reset(&timer_cp);
-  timer_reset(&timer_pp);
-  timer_reset(&timer_controller_shutdown_temperature);
-  timer_reset(&timer_menu);
-  timer_reset(&timer_temp_alarm);
-  timer_reset(&timer_ow_alarm);
-  timer_reset(&timer_in_menu);
-  timer_reset(&timer_out_menu);
+  timer_stop(&timer_cp);
+  timer_stop(&timer_pp);
+  timer_stop(&timer_controller_shutdown_temperature);
+  timer_stop(&timer_menu);
+  timer_stop(&timer_temp_alarm);
+  timer_stop(&timer_out_menu);
   fan_stop();
   timer_out_menu_enabled = false;
   display_enable         = true;
@@ -876,218 +1267,66 @@ stop_alarm(void)
 void
 options_default(void)
 {
-  options.fan_work_duration            = (Option){ 10, 5, 95 }; // 5-95 seconds
-  options.fan_pause_duration           = (Option){ 3, 1, 99 };  // 1-99 minutes
-  options.fan_speed                    = (Option){ 99, 30, 99 };    // 30-99
-  options.fan_power_during_ventilation = (Option){ 90, 30, 99 };    // 30-99
-  options.pump_connection_temperature  = (Option){ 40, 25, 70 };    // 25-70
-  options.hysteresis                   = (Option){ 3, 1, 9 };       // 1-9
-  options.fan_power_reduction          = (Option){ 5, 0, 10 };      // 0-10
-  options.controller_shutdown_temperature = (Option){ 30, 25, 50 }; // 25-50
-  options.sound_signal_enabled            = (Option){ 1, 0, 1 };    // 0-1
-  options.factory_settings                = (Option){ 0, 0, 1 };    // 0-1
-  option_temp_target                      = (Option){ 60, 35, 80 };
-}
+  options_reset();
 
-void
-options_change_params(i8 value)
-{
-  options.e[menu_idx].value
-      = CLAMP(options.e[menu_idx].value + value == UINT8_MAX
-                  ? 0
-                  : options.e[menu_idx].value + value,
-              options.e[menu_idx].min, options.e[menu_idx].max);
+  // Шина калибруется заново сразу, а не при следующей потере датчика:
+  // иначе до неё работали бы старые задержки, а в журнал ушли бы нулевые
+  ow_timing.calibrated = false;
+  temp_restart(&temp_ctx);
 }
 
 void
 options_save(void)
 {
-  return;
-  u16 eeprom_pos = sizeof(u8);
-
-  disable_interrupts();
-
-  // u16 i;
-  // for (i = 0; i < 512; i++) {
-  //   eeprom_write_byte((u8 *)i, 0);
-  // }
-
-  eeprom_write_byte((u8 *)0x0, 1);
+  u8 payload[OPTIONS_PAYLOAD_SIZE];
 
-  eeprom_write_block((const void *)&options, (void *)eeprom_pos,
-                     sizeof(Options));
-  eeprom_pos += sizeof(Options);
+  // Задержки слотов живут в ow_timing, в схему они попадают при сохранении
+  options.ow_sample = ow_timing.calibrated ? ow_timing.sample : 0;
+  options.ow_rec    = ow_timing.calibrated ? ow_timing.rec : 0;
 
-  eeprom_write_block((const void *)&option_temp_target, (void *)eeprom_pos,
-                     sizeof(Option));
+  options_pack(payload);
 
-  enable_interrupts();
+  // Запись идёт в фоне, индикатор и кнопки продолжают работать
+  journal_save(payload, sizeof(payload));
 }
 
 void
 options_load(void)
 {
-  return;
-  // u16 i;
-  // for (i = 0; i < 512; i++) {
-  //   eeprom_write_byte((u8 *)i, 0);
-  // }
-
-  // return;
-
-  disable_interrupts();
-
-  u16 eeprom_pos = sizeof(u8);
-
-  if (eeprom_read_byte((u8 *)0x0) == 1) {
-    eeprom_read_block((void *)&options, (void *)eeprom_pos, sizeof(Options));
-    eeprom_pos += sizeof(Options);
-
-    eeprom_read_block((void *)&option_temp_target, (void *)eeprom_pos,
-                      sizeof(Option));
+  u8 payload[OPTIONS_PAYLOAD_SIZE];
 
-    OCR1A = (options.fan_speed.value - 0) * (255 - 0) / (99 - 0) + 0;
-  } else {
-    options_default();
-    options_save();
+  if (!journal_load(payload, sizeof(payload))) {
+    return;
   }
-  enable_interrupts();
-}
-
-u8
-button_pressed(u8 code)
-{
-  return !last_buttons[code] && buttons[code];
-}
-
-u8
-button_released(u8 code)
-{
-  return last_buttons[code] && !buttons[code];
-}
-
-u8
-button_down(u8 code)
-{
-  return last_buttons[code] && buttons[code];
-}
 
-// Инициализация DS18B20
-u8
-ow_reset(void)
-{
-  bool res = false;
+  options_unpack(payload);
 
-  res = ow_skip();
-  if (res) {
-    disable_interrupts();
-    gpio_write_low(&PIN_OW_PORT, PIN_OW);
-    gpio_set_mode_output(&PIN_OW_DDR, PIN_OW);
-    _delay_us(640);
-    gpio_set_mode_input(&PIN_OW_DDR, PIN_OW);
-    _delay_us(80);
-    enable_interrupts();
-    res = !gpio_read(&PIN_OW_READ, PIN_OW);
-    _delay_us(410);
+  // 0 - шина ещё не калибровалась
+  if (options.ow_sample && options.ow_rec) {
+    ow_timing.sample     = CLAMP(options.ow_sample, 1, OW_SAMPLE_MAX);
+    ow_timing.rec        = CLAMP(options.ow_rec, 1, OW_SAMPLE_MAX);
+    ow_timing.calibrated = true;
   }
-
-  return res;
 }
 
 u8
-ow_read_bit(void)
+button_down(u8 code)
 {
-  u8 res = 0;
-
-  disable_interrupts();
-  gpio_set_mode_output(&PIN_OW_DDR, PIN_OW);
-  _delay_us(2);
-  gpio_set_mode_input(&PIN_OW_DDR, PIN_OW);
-  _delay_us(8);
-  res = gpio_read(&PIN_OW_READ, PIN_OW);
-  enable_interrupts();
-  _delay_us(80);
-
-  return res;
+  return buttons.state & code;
 }
 
+// Отпущена раньше BUTTONS_LONG_MS
 u8
-ow_read(void)
-{
-  u8 r = 0;
-  u8 p = 0;
-
-  for (p = 8; p; p--) {
-    r >>= 1;
-    if (ow_read_bit()) {
-      r |= 0x80;
-    }
-  }
-
-  return r;
-}
-
-void
-ow_send_bit(u8 bit)
-{
-  disable_interrupts();
-  gpio_set_mode_output(&PIN_OW_DDR, PIN_OW);
-
-  if (bit) {
-    _delay_us(5);
-    gpio_set_mode_input(&PIN_OW_DDR, PIN_OW);
-    enable_interrupts();
-    _delay_us(90);
-  } else {
-    _delay_us(90);
-    gpio_set_mode_input(&PIN_OW_DDR, PIN_OW);
-    enable_interrupts();
-    _delay_us(5);
-  }
-}
-
-void
-ow_send(u8 byte)
-{
-  u8 p = 0;
-
-  for (p = 8; p; p--) {
-    ow_send_bit(byte & 1);
-    byte >>= 1;
-  }
-}
-
-bool
-ow_skip(void)
+button_short(u8 code)
 {
-  u8 retries = 80;
-
-  disable_interrupts();
-  gpio_set_mode_input(&PIN_OW_DDR, PIN_OW);
-  enable_interrupts();
-
-  do {
-    if (--retries == 0) {
-      return false;
-    }
-    _delay_us(1);
-  } while (!gpio_read(&PIN_OW_READ, PIN_OW));
-
-  return true;
+  return buttons.shorts & code;
 }
 
-// Обновляет значение контольной суммы crc применением всех бит байта b.
-// Возвращает обновлённое значение контрольной суммы
+// Удерживается BUTTONS_LONG_MS, отмечается один раз за нажатие
 u8
-ow_crc_update(u8 crc, u8 byte)
+button_long(u8 code)
 {
-  u8 p = 0;
-
-  for (p = 8; p; p--) {
-    crc = ((crc ^ byte) & 1) ? (crc >> 1) ^ 0b10001100 : (crc >> 1);
-    byte >>= 1;
-  }
-  return crc;
+  return buttons.longs & code;
 }
 
 void
@@ -1128,42 +1367,29 @@ ISR(TIMER0_OVF_vect)
 {
   static u8 ticks = 0;
 
-  if (ticks >= 4) {
-    ticks = 0;
+  sched_clock_overflow();
 
-    switch (state) {
-    case STATE_HOME:
-      display_menu(display_segment_numbers[temp_ctx.temp % 100 / 10],
-                   display_segment_numbers[temp_ctx.temp % 10]);
-      break;
-    case STATE_ALARM:
-      if (error_flags == Error_Temp_Sensor) {
-        display_menu(display_segment_numbers[10], display_segment_numbers[10]);
-      } else {
-        display_menu(display_segment_numbers[temp_ctx.temp % 100 / 10],
-                     display_segment_numbers[temp_ctx.temp % 10]);
-      }
-      break;
-    case STATE_MENU_TEMP_CHANGE:
-      display_menu(
-          display_segment_numbers[option_temp_target.value % 100 / 10],
-          display_segment_numbers[option_temp_target.value % 10]);
-      break;
-    case STATE_MENU:
-      display_menu(display_segment_menu[menu_idx][0],
-                   display_segment_menu[menu_idx][1]);
-      break;
-    case STATE_MENU_PARAMETERS:
-      display_menu(
-          display_segment_numbers[options.e[menu_idx].value % 100 / 10],
-          display_segment_numbers[options.e[menu_idx].value % 10]);
-      break;
-    default:
-      break;
-    }
+  if (ticks >= TIMING_DISPLAY_DIV) {
+    ticks = 0;
+    display_scan();
   }
 
   ticks += 1;
 }
 
-ISR(TIMER2_COMP_vect) { s_ticks += 1; }
+ISR(EE_RDY_vect) { ee_isr(); }
+
+ISR(TIMER2_COMP_vect)
+{
+  // В режиме CTC новое значение действует уже на начавшийся период
+  OCR2 = timing_tick_ocr();
+  s_ticks += 1;
+
+  buttons_sample();
+  fan_step();
+
+  // Конец транзакции 1-Wire сразу будит задачу опроса датчиков
+  if (ow_step()) {
+    sched_signal(task_temp_id);
+  }
+}
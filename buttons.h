@@ -0,0 +1,127 @@
+#ifndef BUTTONS_H
+#define BUTTONS_H
+
+// Подавление дребезга кнопок вертикальным счётчиком.
+//
+// buttons_sample() вызывается из прерывания системного тика и раз в
+// BUTTONS_SAMPLE_TICKS тиков читает все кнопки одним чтением порта. У каждой
+// кнопки двухбитный счётчик, разряды счётчиков всех кнопок лежат в двух
+// байтах, поэтому обработка всех кнопок - несколько логических операций.
+// Состояние кнопки меняется после четырёх одинаковых выборок подряд.
+//
+// Кроме фронтов нажатия и отпускания прерывание отмечает короткое нажатие
+// (отпущена раньше BUTTONS_LONG_MS) и длинное (удерживается
+// BUTTONS_LONG_MS). События копятся до buttons_update(), которая раз за проход задачи кнопок
+// переносит их в buttons. Все маски - биты порта кнопок, 1 - нажата.
+//
+// Перед подключением должны быть определены PIN_BUTTON_READ и
+// PIN_BUTTON_MASK.
+
+#include "core.h"
+
+// Период выборки, тики
+#ifndef BUTTONS_SAMPLE_TICKS
+#define BUTTONS_SAMPLE_TICKS 5
+#endif
+
+#ifndef BUTTONS_LONG_MS
+#define BUTTONS_LONG_MS 2000
+#endif
+
+// Число кнопок в маске
+#define BUTTONS_BIT(n) ((PIN_BUTTON_MASK >> (n)) & 1)
+#define BUTTONS_COUNT                                                         \
+  (BUTTONS_BIT(0) + BUTTONS_BIT(1) + BUTTONS_BIT(2) + BUTTONS_BIT(3)          \
+   + BUTTONS_BIT(4) + BUTTONS_BIT(5) + BUTTONS_BIT(6) + BUTTONS_BIT(7))
+
+#define BUTTONS_LONG_SAMPLES (BUTTONS_LONG_MS / BUTTONS_SAMPLE_TICKS)
+
+typedef struct Buttons {
+  u8 state;    // устойчивое состояние
+  u8 pressed;  // нажаты
+  u8 released; // отпущены
+  u8 shorts;   // отпущены после короткого нажатия
+  u8 longs;    // удерживаются BUTTONS_LONG_MS
+} Buttons;
+
+// События текущего прохода, заполняет buttons_update()
+static Buttons buttons;
+
+// Состояние прерывания
+static volatile Buttons buttons_isr;
+static u8               buttons_cnt0, buttons_cnt1;
+static u8               buttons_div;
+
+// Выборок с нажатия по кнопкам из маски
+static u16 buttons_held[BUTTONS_COUNT];
+
+// Вызывается из прерывания системного тика
+static inline void
+buttons_sample(void)
+{
+  u8 changed, state, bit, i;
+
+  if (++buttons_div < BUTTONS_SAMPLE_TICKS) {
+    return;
+  }
+  buttons_div = 0;
+
+  state = buttons_isr.state;
+
+  // Счётчики отличающихся от состояния кнопок идут вниз с 3, остальные
+  // сбрасываются в 3. Переход через 0 меняет состояние кнопки
+  changed      = state ^ (PIN_BUTTON_READ & PIN_BUTTON_MASK);
+  buttons_cnt0 = ~(buttons_cnt0 & changed);
+  buttons_cnt1 = buttons_cnt0 ^ (buttons_cnt1 & changed);
+  changed &= buttons_cnt0 & buttons_cnt1;
+  state ^= changed;
+
+  buttons_isr.state = state;
+  buttons_isr.pressed |= changed & state;
+  buttons_isr.released |= changed & ~state;
+
+  // Длительности нажатий считаются только для кнопок из маски
+  for (i = 0, bit = 1; bit; bit <<= 1) {
+    if (!(PIN_BUTTON_MASK & bit)) {
+      continue;
+    }
+
+    if (changed & state & bit) {
+      buttons_held[i] = 0;
+    } else if (state & bit) {
+      if (buttons_held[i] < UINT16_MAX) {
+        buttons_held[i] += 1;
+      }
+      if (buttons_held[i] == BUTTONS_LONG_SAMPLES) {
+        buttons_isr.longs |= bit;
+      }
+    } else if ((changed & bit) && buttons_held[i] < BUTTONS_LONG_SAMPLES) {
+      buttons_isr.shorts |= bit;
+    }
+
+    i += 1;
+  }
+}
+
+// Забрать события, накопленные прерыванием с прошлого вызова
+static inline void
+buttons_update(void)
+{
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    buttons = (Buttons){
+      .state    = buttons_isr.state,
+      .pressed  = buttons_isr.pressed,
+      .released = buttons_isr.released,
+      .shorts   = buttons_isr.shorts,
+      .longs    = buttons_isr.longs,
+    };
+
+    buttons_isr.pressed  = 0;
+    buttons_isr.released = 0;
+    buttons_isr.shorts   = 0;
+    buttons_isr.longs    = 0;
+  }
+}
+
+#endif
@@ -6,6 +6,7 @@
 #include "builtin.h"
 
 #include <avr/interrupt.h>
+#include <util/atomic.h>
 #include <util/delay.h>
 
 static inline void
@@ -20,6 +21,15 @@ disable_interrupts(void)
   cli();
 }
 
+// Барьер компилятора: записи в обычную память до него не переносятся за
+// последующие обращения, например за запись индекса, по которому данные
+// забирает прерывание
+static inline void
+memory_barrier(void)
+{
+  __asm__ __volatile__("" ::: "memory");
+}
+
 static inline void
 delay_us(u32 value)
 {
@@ -76,10 +86,27 @@ typedef struct Timer32 {
 
 static volatile u32 s_ticks;
 
+// Снимок счётчика тиков. Четыре байта читаются не одной командой, поэтому
+// прерывание тика на время чтения запрещается
 static inline u32
 get_ticks(void)
 {
-  return s_ticks;
+  u32 res;
+
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    res = s_ticks;
+  }
+
+  return res;
+}
+
+// Разность моментов времени со знаком. Верна через переполнение счётчика,
+// пока моменты отстоят друг от друга меньше чем на 2^31 тиков (24 дня)
+static inline i32
+ticks_diff(u32 a, u32 b)
+{
+  return (i32)(a - b);
 }
 
 static inline void
@@ -100,7 +127,7 @@ timer_expired(u32 *ticks, u32 period, u32 now_ticks)
     *ticks = now_ticks + period;
   }
 
-  if (now_ticks < *ticks) {
+  if (ticks_diff(now_ticks, *ticks) < 0) {
     return false;
   }
 
@@ -124,7 +151,7 @@ timer_expired_ext(Timer32 *self, u32 wait, u32 period, u32 sleep_duration,
       return false;
     }
 
-    if (now_ticks < self->ticks) {
+    if (ticks_diff(now_ticks, self->ticks) < 0) {
       return false;
     }
 
@@ -133,7 +160,7 @@ timer_expired_ext(Timer32 *self, u32 wait, u32 period, u32 sleep_duration,
   }
 
   // Засыпание
-  if (self->sleep_pending && now_ticks <= self->ticks) {
+  if (self->sleep_pending && ticks_diff(now_ticks, self->ticks) <= 0) {
     return false;
   } else if (self->sleep_pending) {
     self->sleep_pending = false;
@@ -141,7 +168,7 @@ timer_expired_ext(Timer32 *self, u32 wait, u32 period, u32 sleep_duration,
   }
 
   // Работа
-  if (self->ticks >= now_ticks) {
+  if (ticks_diff(now_ticks, self->ticks) <= 0) {
     return true;
   }
 
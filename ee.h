@@ -0,0 +1,123 @@
+#ifndef EE_H
+#define EE_H
+
+// Фоновая запись в EEPROM.
+//
+// ee_write() ставит байт в очередь и сразу возвращается, запись идёт в
+// прерывании EE_RDY_vect по одному байту на каждую готовность EEPROM (около
+// 8.5 мс на байт). Байты, совпадающие с уже записанными, пропускаются.
+// ee_flush() дожидается окончания записи, например перед сбросом.
+//
+// ee_isr() должен вызываться из ISR(EE_RDY_vect).
+
+#include "core.h"
+
+#include <avr/eeprom.h>
+
+// Размер очереди, степень двойки
+#ifndef EE_QUEUE_SIZE
+#define EE_QUEUE_SIZE 32
+#endif
+
+// Ожидание в ee_flush() и при полной очереди. На хосте тест-стенд подменяет
+// его шагом виртуальной EEPROM
+#ifndef EE_WAIT
+#define EE_WAIT()
+#endif
+
+typedef struct Ee_Entry {
+  u16 addr;
+  u8  data;
+} Ee_Entry;
+
+static Ee_Entry    ee_queue[EE_QUEUE_SIZE];
+static volatile u8 ee_head, ee_tail; // голова - для прерывания, хвост - для
+                                     // главного цикла
+static volatile bool ee_active;      // идёт запись, прерывание разрешено
+
+static inline bool
+ee_busy(void)
+{
+  return ee_active;
+}
+
+static inline void
+ee_flush(void)
+{
+  while (ee_busy()) {
+    EE_WAIT();
+  }
+}
+
+static inline void
+ee_write(u16 addr, u8 data)
+{
+  u8 tail = ee_tail;
+  u8 next = (tail + 1) & (EE_QUEUE_SIZE - 1);
+
+  // Очередь полна - ждать, пока прерывание освободит место
+  while (next == ee_head) {
+    EE_WAIT();
+  }
+
+  ee_queue[tail] = (Ee_Entry){ addr, data };
+
+  // Элемент должен быть записан до того, как прерывание увидит новый хвост
+  memory_barrier();
+  ee_tail = next;
+
+  ee_active = true;
+  EECR |= (1 << EERIE);
+}
+
+static inline void
+ee_write_block(u16 addr, const void *src, u8 len)
+{
+  const u8 *data = src;
+
+  while (len--) {
+    ee_write(addr++, *data++);
+  }
+}
+
+// Чтение. Ждёт окончания фоновой записи, чтобы не разделять с ней EEAR
+static inline u8
+ee_read(u16 addr)
+{
+  ee_flush();
+  return eeprom_read_byte((const u8 *)(uintptr_t)addr);
+}
+
+static inline void
+ee_read_block(void *dst, u16 addr, u8 len)
+{
+  ee_flush();
+  eeprom_read_block(dst, (const void *)(uintptr_t)addr, len);
+}
+
+// Вызывается из ISR(EE_RDY_vect): запускает запись следующего байта
+static inline void
+ee_isr(void)
+{
+  while (ee_head != ee_tail) {
+    Ee_Entry entry = ee_queue[ee_head];
+
+    ee_head = (ee_head + 1) & (EE_QUEUE_SIZE - 1);
+
+    if (eeprom_read_byte((const u8 *)(uintptr_t)entry.addr) == entry.data) {
+      continue;
+    }
+
+    EEAR = entry.addr;
+    EEDR = entry.data;
+    EECR |= (1 << EEMWE);
+    EECR |= (1 << EEWE);
+    return;
+  }
+
+  // Очередь пуста: последний байт уже записан, раз EEPROM снова готова
+  EECR &= ~(1 << EERIE);
+  ee_active = false;
+}
+
+#endif
@@ -0,0 +1,107 @@
+#ifndef FAN_H
+#define FAN_H
+
+// Вентилятор на ШИМ таймера 1, см. pwm.h.
+//
+// Мощность задаётся в процентах 0..99, как в настройках. Таблица во flash
+// переводит проценты в промилле скважности, деления во время работы нет.
+// fan_set() только меняет цель, саму скважность раз в FAN_SLEW_TICKS тиков
+// сдвигает на FAN_SLEW_STEP промилле fan_step(): вентилятор разгоняется и
+// останавливается плавно, без бросков тока при каждом цикле продувки.
+//
+// fan_step() должен вызываться из прерывания системного тика.
+
+#include "core.h"
+#include "pwm.h"
+
+#include <avr/pgmspace.h>
+#include <util/atomic.h>
+
+// Шаг разгона: полный разгон 0..1000 промилле около 1 с
+#ifndef FAN_SLEW_TICKS
+#define FAN_SLEW_TICKS 4
+#endif
+#define FAN_SLEW_STEP 4
+
+#define FAN_POWER_MAX 99
+
+#define FAN_DUTY(percent) ((percent) * (u32)PWM_PERMILLE_MAX / FAN_POWER_MAX)
+#define FAN_DUTY_ROW(tens)                                                    \
+  FAN_DUTY((tens) * 10 + 0), FAN_DUTY((tens) * 10 + 1),                       \
+      FAN_DUTY((tens) * 10 + 2), FAN_DUTY((tens) * 10 + 3),                   \
+      FAN_DUTY((tens) * 10 + 4), FAN_DUTY((tens) * 10 + 5),                   \
+      FAN_DUTY((tens) * 10 + 6), FAN_DUTY((tens) * 10 + 7),                   \
+      FAN_DUTY((tens) * 10 + 8), FAN_DUTY((tens) * 10 + 9)
+
+static const u16 fan_duty_table[FAN_POWER_MAX + 1] PROGMEM = {
+  FAN_DUTY_ROW(0), FAN_DUTY_ROW(1), FAN_DUTY_ROW(2), FAN_DUTY_ROW(3),
+  FAN_DUTY_ROW(4), FAN_DUTY_ROW(5), FAN_DUTY_ROW(6), FAN_DUTY_ROW(7),
+  FAN_DUTY_ROW(8), FAN_DUTY_ROW(9),
+};
+
+#undef FAN_DUTY_ROW
+#undef FAN_DUTY
+
+static volatile u16 fan_target; // цель, пишет главный цикл
+static volatile u16 fan_duty;   // текущая скважность, пишет прерывание
+static u8           fan_slew;
+
+// Задать скважность в промилле
+static inline void
+fan_set_permille(u16 permille)
+{
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    fan_target = CLAMP_TOP(permille, PWM_PERMILLE_MAX);
+  }
+}
+
+// Скважность в промилле для мощности в процентах
+static inline u16
+fan_power_permille(u8 power)
+{
+  u8 idx = CLAMP_TOP(power, FAN_POWER_MAX);
+
+  return pgm_read_word(&fan_duty_table[idx]);
+}
+
+// Задать мощность в процентах
+static inline void
+fan_set(u8 power)
+{
+  fan_set_permille(fan_power_permille(power));
+}
+
+static inline void
+fan_off(void)
+{
+  fan_set_permille(0);
+}
+
+// Вызывается из прерывания тика: шаг плавного изменения скважности
+static inline void
+fan_step(void)
+{
+  u16 duty   = fan_duty;
+  u16 target = fan_target;
+
+  if (++fan_slew < FAN_SLEW_TICKS) {
+    return;
+  }
+  fan_slew = 0;
+
+  if (duty == target) {
+    return;
+  }
+
+  if (duty < target) {
+    duty = target - duty > FAN_SLEW_STEP ? duty + FAN_SLEW_STEP : target;
+  } else {
+    duty = duty - target > FAN_SLEW_STEP ? duty - FAN_SLEW_STEP : target;
+  }
+
+  fan_duty = duty;
+  pwm_set(duty);
+}
+
+#endif
@@ -0,0 +1,88 @@
+#ifndef GLYPHS_H
+#define GLYPHS_H
+
+// Знаки семисегментного индикатора во flash.
+//
+// Таблица и перечисление Glyph строятся из одного списка GLYPHS, каждый знак
+// описан набором сегментов:
+//
+//    aaa
+//   f   b
+//    ggg
+//   e   c
+//    ddd  dp
+
+#include "builtin.h"
+
+#include <avr/pgmspace.h>
+
+#define SEG_A  (1 << 7)
+#define SEG_B  (1 << 6)
+#define SEG_C  (1 << 5)
+#define SEG_D  (1 << 4)
+#define SEG_E  (1 << 3)
+#define SEG_F  (1 << 2)
+#define SEG_G  (1 << 1)
+#define SEG_DP (1 << 0)
+
+// Первые десять знаков - цифры, их номер совпадает со значением
+#define GLYPHS(X)                                                             \
+  X(0, SEG_A | SEG_B | SEG_C | SEG_D | SEG_E | SEG_F)                         \
+  X(1, SEG_B | SEG_C)                                                         \
+  X(2, SEG_A | SEG_B | SEG_D | SEG_E | SEG_G)                                 \
+  X(3, SEG_A | SEG_B | SEG_C | SEG_D | SEG_G)                                 \
+  X(4, SEG_B | SEG_C | SEG_F | SEG_G)                                         \
+  X(5, SEG_A | SEG_C | SEG_D | SEG_F | SEG_G)                                 \
+  X(6, SEG_A | SEG_C | SEG_D | SEG_E | SEG_F | SEG_G)                         \
+  X(7, SEG_A | SEG_B | SEG_C)                                                 \
+  X(8, SEG_A | SEG_B | SEG_C | SEG_D | SEG_E | SEG_F | SEG_G)                 \
+  X(9, SEG_A | SEG_B | SEG_C | SEG_D | SEG_F | SEG_G)                         \
+  X(Dash, SEG_G)                                                              \
+  X(Blank, 0)                                                                 \
+  X(A, SEG_A | SEG_B | SEG_C | SEG_E | SEG_F | SEG_G)                         \
+  X(b, SEG_C | SEG_D | SEG_E | SEG_F | SEG_G)                                 \
+  X(C, SEG_A | SEG_D | SEG_E | SEG_F)                                         \
+  X(c, SEG_D | SEG_E | SEG_G)                                                 \
+  X(d, SEG_B | SEG_C | SEG_D | SEG_E | SEG_G)                                 \
+  X(E, SEG_A | SEG_D | SEG_E | SEG_F | SEG_G)                                 \
+  X(F, SEG_A | SEG_E | SEG_F | SEG_G)                                         \
+  X(H, SEG_B | SEG_C | SEG_E | SEG_F | SEG_G)                                 \
+  X(I, SEG_E | SEG_F)                                                         \
+  X(L, SEG_D | SEG_E | SEG_F)                                                 \
+  X(n, SEG_C | SEG_E | SEG_G)                                                 \
+  X(O, SEG_A | SEG_B | SEG_C | SEG_D | SEG_E | SEG_F)                         \
+  X(o, SEG_C | SEG_D | SEG_E | SEG_G)                                         \
+  X(P, SEG_A | SEG_B | SEG_E | SEG_F | SEG_G)                                 \
+  X(r, SEG_E | SEG_G)                                                         \
+  X(t, SEG_D | SEG_E | SEG_F | SEG_G)                                         \
+  X(U, SEG_B | SEG_C | SEG_D | SEG_E | SEG_F)                                 \
+  X(u, SEG_C | SEG_D | SEG_E)
+
+#define GLYPH_ENUM(name, segments) Glyph_##name,
+#define GLYPH_SEGMENTS(name, segments) segments,
+
+typedef enum Glyph {
+  GLYPHS(GLYPH_ENUM)
+  Glyph_Count,
+} Glyph;
+
+static const u8 glyph_table[Glyph_Count] PROGMEM = { GLYPHS(GLYPH_SEGMENTS) };
+
+#undef GLYPH_ENUM
+#undef GLYPH_SEGMENTS
+
+// Сегменты знака
+static inline u8
+glyph(u8 idx)
+{
+  return pgm_read_byte(&glyph_table[idx]);
+}
+
+// Коды ошибок E1, E2, E3 ...
+static inline u8
+glyph_error(u8 pos, u8 code)
+{
+  return pos ? glyph(code % 10) : glyph(Glyph_E);
+}
+
+#endif
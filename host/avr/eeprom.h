@@ -0,0 +1,45 @@
+#ifndef HOST_AVR_EEPROM_H
+#define HOST_AVR_EEPROM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <avr/io.h>
+
+// Содержимое EEPROM, стёртые ячейки равны 0xFF
+static uint8_t  host_eeprom[E2END + 1];
+static uint32_t host_eeprom_writes;
+
+static inline uint8_t
+eeprom_read_byte(const uint8_t *addr)
+{
+  return host_eeprom[(uintptr_t)addr & E2END];
+}
+
+static inline void
+eeprom_write_byte(uint8_t *addr, uint8_t value)
+{
+  host_eeprom[(uintptr_t)addr & E2END] = value;
+  host_eeprom_writes += 1;
+}
+
+static inline void
+eeprom_read_block(void *dst, const void *src, size_t n)
+{
+  size_t i;
+  for (i = 0; i < n; i++) {
+    ((uint8_t *)dst)[i] = eeprom_read_byte((const uint8_t *)src + i);
+  }
+}
+
+static inline void
+eeprom_write_block(const void *src, void *dst, size_t n)
+{
+  size_t i;
+  for (i = 0; i < n; i++) {
+    eeprom_write_byte((uint8_t *)dst + i, ((const uint8_t *)src)[i]);
+  }
+}
+
+#endif
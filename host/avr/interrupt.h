@@ -0,0 +1,13 @@
+#ifndef HOST_AVR_INTERRUPT_H
+#define HOST_AVR_INTERRUPT_H
+
+#include <avr/io.h>
+
+// Флаг I в виртуальном SREG, прерывания вызываются тест-стендом вручную
+#define sei() (SREG |= (1 << SREG_I))
+#define cli() (SREG &= ~(1 << SREG_I))
+
+// Обработчик прерывания - обычная функция, например TIMER0_OVF_vect()
+#define ISR(vector, ...) void vector(void)
+
+#endif
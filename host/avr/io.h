@@ -0,0 +1,148 @@
+#ifndef HOST_AVR_IO_H
+#define HOST_AVR_IO_H
+
+// Виртуальный регистровый файл ATmega8 для сборки на хосте.
+// Регистры - обычные поля структуры, тест-стенд читает и пишет их напрямую.
+
+#include <stdint.h>
+
+typedef struct Host_Io {
+  uint8_t portb, ddrb, pinb;
+  uint8_t portc, ddrc, pinc;
+  uint8_t portd, ddrd, pind;
+
+  uint8_t  tccr0, tcnt0;
+  uint8_t  tccr1a, tccr1b;
+  uint16_t tcnt1, ocr1a, ocr1b, icr1;
+  uint8_t  tccr2, tcnt2, ocr2;
+  uint8_t  timsk, tifr;
+
+  uint8_t  eecr, eedr;
+  uint16_t eear;
+
+  uint8_t sreg;
+} Host_Io;
+
+static volatile Host_Io host_io;
+
+#define PORTB host_io.portb
+#define DDRB  host_io.ddrb
+#define PINB  host_io.pinb
+#define PORTC host_io.portc
+#define DDRC  host_io.ddrc
+#define PINC  host_io.pinc
+#define PORTD host_io.portd
+#define DDRD  host_io.ddrd
+#define PIND  host_io.pind
+
+#define TCCR0  host_io.tccr0
+#define TCNT0  host_io.tcnt0
+#define TCCR1A host_io.tccr1a
+#define TCCR1B host_io.tccr1b
+#define TCNT1  host_io.tcnt1
+#define OCR1A  host_io.ocr1a
+#define OCR1B  host_io.ocr1b
+#define ICR1   host_io.icr1
+#define TCCR2  host_io.tccr2
+#define TCNT2  host_io.tcnt2
+#define OCR2   host_io.ocr2
+#define TIMSK  host_io.timsk
+#define TIFR   host_io.tifr
+
+#define EECR host_io.eecr
+#define EEDR host_io.eedr
+#define EEAR host_io.eear
+
+#define SREG host_io.sreg
+
+#define PB0 0
+#define PB1 1
+#define PB2 2
+#define PB3 3
+#define PB4 4
+#define PB5 5
+#define PB6 6
+#define PB7 7
+
+#define PC0 0
+#define PC1 1
+#define PC2 2
+#define PC3 3
+#define PC4 4
+#define PC5 5
+#define PC6 6
+
+#define PD0 0
+#define PD1 1
+#define PD2 2
+#define PD3 3
+#define PD4 4
+#define PD5 5
+#define PD6 6
+#define PD7 7
+
+// TCCR0
+#define CS00 0
+#define CS01 1
+#define CS02 2
+
+// TCCR1A
+#define WGM10  0
+#define WGM11  1
+#define FOC1B  2
+#define FOC1A  3
+#define COM1B0 4
+#define COM1B1 5
+#define COM1A0 6
+#define COM1A1 7
+
+// TCCR1B
+#define CS10  0
+#define CS11  1
+#define CS12  2
+#define WGM12 3
+#define WGM13 4
+#define ICES1 6
+#define ICNC1 7
+
+// TCCR2
+#define CS20  0
+#define CS21  1
+#define CS22  2
+#define WGM21 3
+#define COM20 4
+#define COM21 5
+#define WGM20 6
+#define FOC2  7
+
+// TIMSK
+#define TOIE0  0
+#define TOIE1  2
+#define OCIE1B 3
+#define OCIE1A 4
+#define TICIE1 5
+#define TOIE2  6
+#define OCIE2  7
+
+// TIFR
+#define TOV0  0
+#define TOV1  2
+#define OCF1B 3
+#define OCF1A 4
+#define ICF1  5
+#define TOV2  6
+#define OCF2  7
+
+// EECR
+#define EERE  0
+#define EEWE  1
+#define EEMWE 2
+#define EERIE 3
+
+// SREG
+#define SREG_I 7
+
+// Последний адрес EEPROM
+#define E2END 0x1FF
+
+#endif
@@ -0,0 +1,76 @@
+// Сравнение реализаций CRC-8 на хосте.
+//
+// Собирается отдельно для каждого значения CRC8_IMPL (make bench-crc),
+// проверяет результат против побитового эталона и считает время на байт.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../crc8.h"
+
+static const char *impl_names[] = { "bitwise", "nibble", "table" };
+
+static u8
+crc8_reference(u8 crc, u8 byte)
+{
+  u8 p = 0;
+
+  for (p = 8; p; p--) {
+    crc = ((crc ^ byte) & 1) ? (crc >> 1) ^ 0x8C : (crc >> 1);
+    byte >>= 1;
+  }
+  return crc;
+}
+
+static double
+host_now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+int
+main(int argc, char **argv)
+{
+  // ПЗУ из Maxim AN27: CRC первых семи байт равен последнему
+  static const u8 rom[8] = { 0x02, 0x1C, 0xB8, 0x01, 0x00, 0x00, 0x00, 0xA2 };
+
+  u32 rounds = argc > 1 ? strtoul(argv[1], 0, 0) : 10000000UL;
+  u32 i, c;
+
+  if (crc8(rom, 7) != rom[7]) {
+    printf("%-8s FAIL: rom crc 0x%02x\n", impl_names[CRC8_IMPL],
+           crc8(rom, 7));
+    return 1;
+  }
+
+  for (i = 0; i < 256; i++) {
+    for (c = 0; c < 256; c++) {
+      if (crc8_update(c, i) != crc8_reference(c, i)) {
+        printf("%-8s FAIL: crc 0x%02x byte 0x%02x\n", impl_names[CRC8_IMPL],
+               c, i);
+        return 1;
+      }
+    }
+  }
+
+  // Скретчпад DS18B20 - 9 байт на одно чтение
+  volatile u8 scratchpad[9] = { 0x50, 0x05, 0x4B, 0x46, 0x7F,
+                                0xFF, 0x0C, 0x10, 0x1C };
+  u8          crc           = 0;
+
+  double begin = host_now();
+  for (i = 0; i < rounds; i++) {
+    for (c = 0; c < 9; c++) {
+      crc = crc8_update(crc, scratchpad[c]);
+    }
+  }
+  double elapsed = host_now() - begin;
+
+  printf("%-8s %6.2f ns/byte (crc 0x%02x)\n", impl_names[CRC8_IMPL],
+         elapsed * 1e9 / ((double)rounds * 9), crc);
+
+  return 0;
+}
@@ -0,0 +1,118 @@
+#ifndef HOST_HARNESS_H
+#define HOST_HARNESS_H
+
+// Общая часть тест-стенда и тестов на хосте.
+//
+// boiler.c собирается как есть, поверх виртуальных регистров из host/avr.
+// Стенд сам двигает системное время: host_tick() вызывает TIMER2_COMP_vect
+// (1 мс), раз в TIMING_TIMER0_OVF_US - TIMER0_OVF_vect (обновление
+// индикатора) и шаг виртуальной EEPROM. Время выполнения задач планировщик
+// меряет по часам хоста.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static double
+host_now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// Часы планировщика в наносекундах хоста
+#define SCHED_CLOCK() ((uint16_t)(uint64_t)(host_now() * 1e9))
+
+// Ожидание фоновой записи EEPROM двигает виртуальную EEPROM
+static void host_eeprom_step(void);
+#define EE_WAIT() host_eeprom_step()
+
+#define main boiler_main
+#include "../boiler.c"
+#undef main
+
+// Виртуальная EEPROM: запись байта, начатая битом EEWE, завершается к
+// следующему шагу, после чего при разрешённом EERIE вызывается EE_RDY_vect
+static void
+host_eeprom_step(void)
+{
+  if (EECR & (1 << EEWE)) {
+    eeprom_write_byte((u8 *)(uintptr_t)EEAR, EEDR);
+    EECR &= ~((1 << EEWE) | (1 << EEMWE));
+  }
+
+  if (EECR & (1 << EERIE)) {
+    EE_RDY_vect();
+  }
+}
+
+static void
+host_tick(void)
+{
+  static u32 us = 0;
+
+  TIMER2_COMP_vect();
+  host_eeprom_step();
+
+  // Переполнения таймера 0 с их настоящим периодом
+  for (us += 1000000UL / TIMING_TICK_HZ; us >= TIMING_TIMER0_OVF_US;
+       us -= TIMING_TIMER0_OVF_US) {
+    TIMER0_OVF_vect();
+  }
+}
+
+// Чистая EEPROM и свободная линия 1-Wire (датчик не отвечает)
+static inline void
+host_begin(void)
+{
+  memset(host_eeprom, 0xFF, sizeof(host_eeprom));
+  PINB |= (1 << PIN_OW);
+}
+
+// Проходов главного цикла на тик в host_run()
+#define HOST_PASSES_PER_TICK 4
+
+// ms тиков работы с удержанием кнопок buttons (маски Button)
+static inline void
+host_run(u32 ms, u8 buttons)
+{
+  u32 i, n;
+
+  PINB = (PINB & ~PIN_BUTTON_MASK) | buttons;
+
+  for (i = 0; i < ms; i++) {
+    for (n = 0; n < HOST_PASSES_PER_TICK; n++) {
+      sched_run(get_ticks());
+    }
+    host_tick();
+  }
+}
+
+// Нажатие длиной ms и отпускание с паузой после него
+static inline void
+host_press(u8 buttons, u32 ms, u32 after)
+{
+  host_run(ms, buttons);
+  host_run(after, 0);
+}
+
+static unsigned host_failures;
+
+#define HOST_CHECK(cond)                                                      \
+  do {                                                                        \
+    if (!(cond)) {                                                            \
+      printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond);         \
+      host_failures += 1;                                                     \
+    }                                                                         \
+  } while (0)
+
+// Итог теста: код возврата процесса
+static inline int
+host_report(const char *name)
+{
+  printf("%s: %s\n", name, host_failures ? "FAILED" : "ok");
+  return host_failures ? 1 : 0;
+}
+
+#endif
@@ -0,0 +1,79 @@
+// Тест-стенд для запуска прошивки на хосте, см. harness.h. Каждые
+// passes_per_tick проходов главного цикла вызывается host_tick().
+//
+//   ./boiler_sim [проходов] [проходов_на_тик] [линия_1wire]
+
+#include "harness.h"
+
+int
+main(int argc, char **argv)
+{
+  u64 passes          = argc > 1 ? strtoull(argv[1], 0, 0) : 10000000ULL;
+  u32 passes_per_tick = argc > 2 ? strtoul(argv[2], 0, 0) : 100;
+  u8  ow_line         = argc > 3 ? strtoul(argv[3], 0, 0) : 1;
+
+  if (passes_per_tick == 0) {
+    passes_per_tick = 1;
+  }
+
+  host_begin();
+
+  // 0 - линия 1-Wire прижата к земле
+  if (!ow_line) {
+    PINB &= ~(1 << PIN_OW);
+  }
+
+  boiler_init();
+
+  double begin = host_now();
+  u64    i;
+  u32    n = 0;
+
+  for (i = 0; i < passes; i++) {
+    sched_run(get_ticks());
+
+    if (++n >= passes_per_tick) {
+      n = 0;
+      host_tick();
+    }
+  }
+
+  double elapsed = host_now() - begin;
+
+  printf("passes:        %llu\n", (unsigned long long)passes);
+  printf("elapsed:       %.3f s\n", elapsed);
+  printf("passes/s:      %.0f\n", elapsed > 0 ? passes / elapsed : 0.0);
+  printf("ticks:         %lu ms\n", (unsigned long)get_ticks());
+  printf("busy wait:     %llu us\n", (unsigned long long)host_delay_us);
+  printf("state:         %u\n", state);
+  printf("mode:          %u\n", mode);
+  printf("error_flags:   0x%02x\n", error_flags);
+  printf("temp:          %d/16 C\n", temp_ctx.temp);
+  printf("trend:         %d/16 C/min\n", temp_trend());
+  printf("sensors:       %u (valid 0x%02x)\n", temp_ctx.sensors,
+         temp_ctx.valid);
+  printf("1-wire errors: presence %u, crc %u\n", temp_ctx.presence_errors,
+         temp_ctx.crc_errors);
+  printf("1-wire timing: sample %u, rec %u loops, rise %u cycles%s\n",
+         ow_timing.sample, ow_timing.rec, ow_timing.rise,
+         ow_timing.calibrated ? "" : " (default)");
+  printf("pwm:           OCR1A %u, ICR1 %u, %lu Hz\n", OCR1A, ICR1,
+         (unsigned long)TIMING_PWM_HZ);
+  printf("pi worst:      %u ns\n", control_pi_worst);
+  printf("TCCR1A:        0x%02x\n", TCCR1A);
+  printf("PORTC (leds):  0x%02x\n", PORTC);
+  printf("display:       0x%02x 0x%02x%s\n",
+         (u8)~display_frames[display_front].digits[0],
+         (u8)~display_frames[display_front].digits[1],
+         display_frames[display_front].enabled ? "" : " (off)");
+  printf("eeprom writes: %lu\n", (unsigned long)host_eeprom_writes);
+
+  printf("\ntask  prio  period      runs  worst, ns\n");
+  for (i = 0; i < sched_count; i++) {
+    const Task *task = sched_task(i);
+    printf("%4u  %4u  %6u  %8lu  %9u\n", (unsigned)i, task->priority,
+           task->period, (unsigned long)task->runs, task->worst);
+  }
+
+  return 0;
+}
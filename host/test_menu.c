@@ -0,0 +1,79 @@
+// Меню по нажатиям кнопок: правка уставки с ускоряющимся автоповтором,
+// сохранение, вход в меню удержанием MENU, выбор пункта, правка параметра,
+// выход по бездействию и возврат индикатора после мигания уставки.
+
+// Датчика на шине нет: тревога по его потере не должна прервать сценарий
+#define TEMP_LOST_TIMEOUT SECONDS(30)
+
+#include "harness.h"
+
+int
+main(void)
+{
+  u8  target = 0;
+  u32 i      = 0;
+
+  host_begin();
+  boiler_init();
+  host_run(100, 0);
+
+  HOST_CHECK(state == STATE_HOME);
+  target = options.temp_target;
+
+  // Удержание UP 1 с: шаг при нажатии, первый повтор через 500 мс, дальше
+  // каждые 100 мс
+  host_press(BUTTON_UP, 1000, 50);
+  HOST_CHECK(state == STATE_MENU_TEMP_CHANGE);
+  HOST_CHECK(options.temp_target >= target + 5);
+  HOST_CHECK(options.temp_target <= target + 8);
+  target = options.temp_target;
+
+  // Короткое нажатие MENU сохраняет уставку и возвращает на главный экран
+  host_press(BUTTON_MENU, 50, 300);
+  HOST_CHECK(state == STATE_HOME);
+  HOST_CHECK(host_eeprom_writes > 0);
+
+  // Удержание MENU 2 с - вход в меню настроек
+  host_press(BUTTON_MENU, 2200, 200);
+  HOST_CHECK(state == STATE_MENU);
+  HOST_CHECK(menu_selected == 0);
+
+  // UP - следующий пункт, PP
+  host_press(BUTTON_UP, 50, 150);
+  HOST_CHECK(menu_selected == Option_fan_pause_duration);
+
+  // MENU - правка PP, удержание DOWN доводит значение до минимума
+  host_press(BUTTON_MENU, 50, 150);
+  HOST_CHECK(state == STATE_MENU_PARAMETERS);
+  host_press(BUTTON_DOWN, 2000, 100);
+  HOST_CHECK(options.fan_pause_duration
+             == option_min(Option_fan_pause_duration));
+
+  // MENU - обратно к списку, 5 с без нажатий - выход на главный экран
+  host_press(BUTTON_MENU, 50, 150);
+  HOST_CHECK(state == STATE_MENU);
+  host_run(5500, 0);
+  HOST_CHECK(state == STATE_HOME);
+
+  // Выход из правки уставки в фазе, когда мигающий индикатор погашен
+  host_press(BUTTON_UP, 50, 0);
+  for (i = 0; i < 600 && display_enable; i++) {
+    host_run(1, 0);
+  }
+  HOST_CHECK(state == STATE_MENU_TEMP_CHANGE);
+  HOST_CHECK(!display_enable);
+  target = options.temp_target;
+  host_press(BUTTON_MENU, 50, 3000);
+  HOST_CHECK(state == STATE_HOME);
+  HOST_CHECK(display_enable);
+  HOST_CHECK(display_frames[display_front].enabled);
+
+  // Уставка пережила перезагрузку
+  options_reset();
+  options_load();
+  HOST_CHECK(options.temp_target == target);
+  HOST_CHECK(options.fan_pause_duration
+             == option_min(Option_fan_pause_duration));
+
+  return host_report("test_menu");
+}
@@ -0,0 +1,92 @@
+// Переполнение счётчика тиков: программные таймеры всех единиц и задачи
+// планировщика работают через переход 0xFFFFFFFF -> 0 так же, как без него.
+
+#define TEMP_LOST_TIMEOUT SECONDS(30)
+
+#include "harness.h"
+
+#define WRAP_BEFORE 4096UL
+#define WRAP_RUN    10000UL
+
+static void
+test_timers(void)
+{
+  static Timer once_s  = TIMER_UNIT(Timer_Unit_Second);
+  static Timer once_10 = TIMER_UNIT(Timer_Unit_10ms);
+  static Timer every   = TIMER_UNIT(Timer_Unit_Tick);
+  static Timer duty    = TIMER_UNIT(Timer_Unit_Second);
+
+  u32  start   = 0xFFFFFFFFUL - 3 * 60000UL + 777;
+  u32  fired_s = 0, fired_10 = 0, count = 0, t = 0, i = 0;
+  u32  edges   = 0;
+  bool on      = false;
+
+  timers_update(start);
+
+  for (i = 0; i < 200000UL; i++) {
+    t = start + i;
+    timers_update(t);
+
+    if (!fired_s && timer_once(&once_s, 5000, t)) {
+      fired_s = t - start;
+    }
+    if (!fired_10 && timer_once(&once_10, 95, t)) {
+      fired_10 = t - start;
+    }
+    if (timer_every(&every, 250, t)) {
+      count += 1;
+    }
+    if (timer_duty(&duty, 3000, 2000, 5000, t) != on) {
+      on = !on;
+      edges += 1;
+    }
+  }
+
+  // Крупная единица округляет срок вверх, но не больше чем на единицу
+  HOST_CHECK(fired_s >= 5000 && fired_s < 6000);
+  HOST_CHECK(fired_10 >= 95 && fired_10 < 105);
+  HOST_CHECK(count == 200000UL / 250 - 1);
+
+  // После 3 с ожидания циклы 2 с работы и 5 с паузы: ~28 циклов
+  HOST_CHECK(edges >= 2 * 27 && edges <= 2 * 29);
+}
+
+static void
+test_tasks(void)
+{
+  u8 i;
+
+  s_ticks = 0xFFFFFFFFUL - WRAP_BEFORE;
+
+  host_begin();
+  boiler_init();
+  host_run(WRAP_RUN, 0);
+
+  HOST_CHECK(get_ticks() == WRAP_RUN - WRAP_BEFORE - 1);
+
+  // Периодические задачи не застревают на переходе и не срабатывают лишний
+  // раз
+  for (i = 0; i < sched_count; i++) {
+    const Task *task = sched_task(i);
+
+    if (!task->period) {
+      continue;
+    }
+
+    HOST_CHECK(task->runs + 1 >= WRAP_RUN / task->period);
+
+    // Задачу опроса датчиков сверх периода будит конец транзакции 1-Wire
+    if (i != task_temp_id) {
+      HOST_CHECK(task->runs <= WRAP_RUN / task->period + 1);
+    }
+  }
+}
+
+int
+main(void)
+{
+  test_timers();
+  test_tasks();
+
+  return host_report("test_wrap");
+}
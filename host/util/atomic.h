@@ -0,0 +1,27 @@
+#ifndef HOST_UTIL_ATOMIC_H
+#define HOST_UTIL_ATOMIC_H
+
+#include <avr/interrupt.h>
+
+// Как в avr-libc: блок выполняется один раз с запрещёнными прерываниями,
+// при выходе SREG восстанавливается
+static inline void
+host_atomic_restore(const uint8_t *sreg)
+{
+  SREG = *sreg;
+}
+
+static inline uint8_t
+host_atomic_cli(void)
+{
+  cli();
+  return 1;
+}
+
+#define ATOMIC_RESTORESTATE                                                   \
+  uint8_t host_sreg __attribute__((__cleanup__(host_atomic_restore))) = SREG
+
+#define ATOMIC_BLOCK(type)                                                    \
+  for (type, host_todo = host_atomic_cli(); host_todo; host_todo = 0)
+
+#endif
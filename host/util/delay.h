@@ -0,0 +1,22 @@
+#ifndef HOST_UTIL_DELAY_H
+#define HOST_UTIL_DELAY_H
+
+#include <stdint.h>
+
+// Задержки не ждут, а только накапливают время, которое прошивка провела бы
+// в активном ожидании
+static uint64_t host_delay_us;
+
+static inline void
+_delay_us(double us)
+{
+  host_delay_us += (uint64_t)us;
+}
+
+static inline void
+_delay_ms(double ms)
+{
+  host_delay_us += (uint64_t)(ms * 1000.0);
+}
+
+#endif
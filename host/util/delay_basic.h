@@ -0,0 +1,13 @@
+#ifndef HOST_UTIL_DELAY_BASIC_H
+#define HOST_UTIL_DELAY_BASIC_H
+
+#include <util/delay.h>
+
+// Проход цикла _delay_loop_1 - 3 такта, 0 - 256 проходов
+static inline void
+_delay_loop_1(uint8_t count)
+{
+  host_delay_us += (count ? count : 256) * 3 / (F_CPU / 1000000UL);
+}
+
+#endif
@@ -0,0 +1,163 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+// Журнал настроек в EEPROM с выравниванием износа.
+//
+// EEPROM разбита на JOURNAL_SLOTS слотов по JOURNAL_SLOT_SIZE байт. Каждое
+// сохранение пишет новую запись в следующий слот по кругу:
+//
+//   [seq][данные ...][crc]
+//
+// seq - порядковый номер записи (0..0xFE, 0xFF - стёртая ячейка), crc -
+// CRC-8 номера и данных с начальным значением JOURNAL_VERSION, поэтому записи
+// другой версии раскладки считаются недействительными. При загрузке берётся
+// самая новая запись с верной CRC. Неизменённые настройки не сохраняются, а
+// байты, совпадающие со старым содержимым слота, не перезаписываются.
+
+#include "core.h"
+#include "crc8.h"
+#include "ee.h"
+
+// Версию задаёт владелец раскладки данных, см. options.h
+#ifndef JOURNAL_VERSION
+#error "JOURNAL_VERSION is not defined"
+#endif
+
+#define JOURNAL_SLOT_SIZE   16
+#define JOURNAL_SLOTS       ((E2END + 1) / JOURNAL_SLOT_SIZE)
+#define JOURNAL_PAYLOAD_MAX (JOURNAL_SLOT_SIZE - 2)
+#define JOURNAL_SEQ_ERASED  0xFF
+
+typedef struct Journal {
+  u8   slot, seq; // последняя действительная запись
+  bool valid;
+  u8   last[JOURNAL_PAYLOAD_MAX]; // её данные
+} Journal;
+
+static Journal journal;
+
+// Новее ли номер a номера b с учётом переполнения
+static inline bool
+journal_seq_newer(u8 a, u8 b)
+{
+  return (i8)(a - b) > 0;
+}
+
+static inline u8
+journal_seq_next(u8 seq)
+{
+  return seq + 1 == JOURNAL_SEQ_ERASED ? 0 : seq + 1;
+}
+
+static inline u16
+journal_slot_addr(u8 slot)
+{
+  return (u16)slot * JOURNAL_SLOT_SIZE;
+}
+
+// Проверка CRC записи в слоте, при успехе данные копируются в payload
+static inline bool
+journal_check(u8 slot, u8 *payload, u8 len)
+{
+  u16 addr = journal_slot_addr(slot);
+  u8  crc  = crc8_update(JOURNAL_VERSION, ee_read(addr));
+  u8  i;
+
+  for (i = 0; i < len; i++) {
+    payload[i] = ee_read(addr + 1 + i);
+    crc        = crc8_update(crc, payload[i]);
+  }
+
+  return ee_read(addr + 1 + len) == crc;
+}
+
+// Поиск самой новой действительной записи. Сначала по номерам выбирается
+// кандидат, CRC проверяется только у него; при ошибке берётся следующий
+static inline bool
+journal_load(void *payload, u8 len)
+{
+  u8  seqs[JOURNAL_SLOTS];
+  u32 rejected = 0;
+  u8  i;
+
+  journal.valid = false;
+
+  if (len > JOURNAL_PAYLOAD_MAX) {
+    return false;
+  }
+
+  for (i = 0; i < JOURNAL_SLOTS; i++) {
+    seqs[i] = ee_read(journal_slot_addr(i));
+  }
+
+  for (;;) {
+    u8   best  = 0;
+    bool found = false;
+
+    for (i = 0; i < JOURNAL_SLOTS; i++) {
+      if (seqs[i] == JOURNAL_SEQ_ERASED || (rejected & ((u32)1 << i))) {
+        continue;
+      }
+
+      if (!found || journal_seq_newer(seqs[i], seqs[best])) {
+        best  = i;
+        found = true;
+      }
+    }
+
+    if (!found) {
+      return false;
+    }
+
+    if (journal_check(best, journal.last, len)) {
+      journal.slot  = best;
+      journal.seq   = seqs[best];
+      journal.valid = true;
+      memcpy(payload, journal.last, len);
+      return true;
+    }
+
+    rejected |= (u32)1 << best;
+  }
+}
+
+// Сохранение в следующий слот. Запись идёт в фоне через ee.h
+static inline void
+journal_save(const void *payload, u8 len)
+{
+  u16 addr;
+  u8  crc, i;
+
+  if (len > JOURNAL_PAYLOAD_MAX) {
+    return;
+  }
+
+  if (journal.valid && memcmp(journal.last, payload, len) == 0) {
+    return;
+  }
+
+  if (journal.valid) {
+    journal.slot = (journal.slot + 1) % JOURNAL_SLOTS;
+    journal.seq  = journal_seq_next(journal.seq);
+  } else {
+    journal.slot = 0;
+    journal.seq  = 0;
+  }
+
+  memcpy(journal.last, payload, len);
+  journal.valid = true;
+
+  addr = journal_slot_addr(journal.slot);
+  crc  = crc8_update(JOURNAL_VERSION, journal.seq);
+  for (i = 0; i < len; i++) {
+    crc = crc8_update(crc, journal.last[i]);
+  }
+
+  // Номер пишется последним: до этого слот остаётся старой записью с
+  // неверной CRC и при загрузке пропускается
+  ee_write_block(addr + 1, journal.last, len);
+  ee_write(addr + 1 + len, crc);
+  ee_write(addr, journal.seq);
+}
+
+#endif
@@ -0,0 +1,140 @@
+#ifndef MENU_H
+#define MENU_H
+
+// Табличное меню.
+//
+// Каждое состояние интерфейса описывается узлом Menu_Node во flash: какую
+// настройку меняют кнопки MENU_KEY_UP/MENU_KEY_DOWN, с каким профилем
+// автоповтора, куда переходить по MENU_KEY_ENTER и после изменения значения.
+// Пункты меню - настройки схемы до OPTIONS_MENU_COUNT. Узел с флагом
+// MENU_LIST выбирает пункт, узел с флагом MENU_ITEM правит выбранный пункт.
+//
+// Автоповтор ускоряется при удержании: первый повтор через delay, дальше с
+// периодом period, а после удержания fast_after - с периодом fast_period.
+//
+// Перед подключением должны быть определены MENU_KEY_UP, MENU_KEY_DOWN и
+// MENU_KEY_ENTER - маски кнопок из buttons.h.
+
+#include "buttons.h"
+#include "core.h"
+#include "glyphs.h"
+#include "options.h"
+#include "timer.h"
+
+#include <avr/pgmspace.h>
+
+typedef struct Menu_Repeat {
+  u16 delay;       // первый повтор после нажатия, мс
+  u16 fast_after;  // удержание до ускорения, мс
+  u8  period;      // период повторов, мс
+  u8  fast_period; // период после ускорения, мс
+} Menu_Repeat;
+
+#define MENU_STAY UINT8_MAX // без перехода
+#define MENU_NONE UINT8_MAX // без настройки
+
+// Флаги узла
+#define MENU_LIST    (1 << 0) // кнопки выбирают пункт
+#define MENU_ITEM    (1 << 1) // кнопки правят выбранный пункт
+#define MENU_SAVE    (1 << 2) // сохранить настройки при выходе по ENTER
+#define MENU_TIMEOUT (1 << 3) // выход по бездействию
+
+typedef struct Menu_Node {
+  const Menu_Repeat *repeat;   // профиль автоповтора во flash
+  u8                 option;   // настройка, MENU_NONE - кнопки не действуют
+  u8                 on_enter; // состояние по нажатию ENTER
+  u8                 on_edit;  // состояние после изменения значения
+  u8                 flags;
+} Menu_Node;
+
+typedef enum Menu_Event {
+  Menu_Event_None = 0,
+  Menu_Event_Edit,  // значение изменено кнопкой
+  Menu_Event_Enter, // нажата ENTER, переход в on_enter
+} Menu_Event;
+
+static u8    menu_selected; // выбранный пункт
+static Timer menu_timer;
+static u32   menu_pressed_at;
+
+// Сегменты знака пункта, у второго разряда горит точка
+static inline u8
+menu_item_glyph(u8 idx, u8 pos)
+{
+  return glyph(option_glyph(idx, pos)) | (pos ? SEG_DP : 0);
+}
+
+// Узел из flash
+static inline void
+menu_node(Menu_Node *node, const Menu_Node *nodes, u8 state)
+{
+  memcpy_P(node, &nodes[state], sizeof(*node));
+}
+
+// Настройка, которую меняют кнопки в узле
+static inline u8
+menu_option(const Menu_Node *node)
+{
+  return node->flags & MENU_ITEM ? menu_selected : node->option;
+}
+
+static inline void
+menu_select(i8 delta)
+{
+  i16 idx = (i16)menu_selected + delta;
+
+  menu_selected = CLAMP(idx, 0, OPTIONS_MENU_COUNT - 1);
+}
+
+// Обработка кнопок в узле, вызывается после buttons_update()
+static inline Menu_Event
+menu_handle(const Menu_Node *node, u32 now_ticks)
+{
+  Menu_Repeat repeat;
+  u16         held  = 0;
+  i8          delta = 0;
+
+  if (node->on_enter != MENU_STAY && (buttons.pressed & MENU_KEY_ENTER)) {
+    timer_stop(&menu_timer);
+    return Menu_Event_Enter;
+  }
+
+  if (menu_option(node) == MENU_NONE && !(node->flags & MENU_LIST)) {
+    return Menu_Event_None;
+  }
+
+  memcpy_P(&repeat, node->repeat, sizeof(repeat));
+
+  if (buttons.pressed & (MENU_KEY_UP | MENU_KEY_DOWN)) {
+    delta           = buttons.pressed & MENU_KEY_UP ? 1 : -1;
+    menu_pressed_at = now_ticks;
+
+    timer_stop(&menu_timer);
+    timer_once(&menu_timer, repeat.delay, now_ticks);
+  } else if (buttons.state & (MENU_KEY_UP | MENU_KEY_DOWN)) {
+    if (!timer_once(&menu_timer, repeat.delay, now_ticks)) {
+      return Menu_Event_None;
+    }
+
+    delta = buttons.state & MENU_KEY_UP ? 1 : -1;
+    held  = CLAMP_TOP(now_ticks - menu_pressed_at, UINT16_MAX);
+
+    timer_stop(&menu_timer);
+    timer_once(&menu_timer,
+               held < repeat.fast_after ? repeat.period : repeat.fast_period,
+               now_ticks);
+  } else {
+    timer_stop(&menu_timer);
+    return Menu_Event_None;
+  }
+
+  if (node->flags & MENU_LIST) {
+    menu_select(delta);
+  } else {
+    option_step(menu_option(node), delta);
+  }
+
+  return Menu_Event_Edit;
+}
+
+#endif
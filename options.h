@@ -0,0 +1,146 @@
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+// Схема настроек.
+//
+// Каждая настройка описана в списке OPTIONS один раз: имя, знаки пункта
+// меню, значение по умолчанию и пределы. Из списка строятся перечисление
+// Option_Id, значения в RAM (options), таблица пределов и знаков во flash и
+// раскладка записи журнала: значения в порядке списка. Настройки до
+// OPTIONS_MENU_COUNT показываются в меню настроек, остальные - уставка и
+// задержки слотов 1-Wire, которые подбирает калибровка (0 - шина не
+// калибровалась).
+//
+// Раскладка записи зависит от схемы, поэтому журнал проверяет CRC с
+// начальным значением OPTIONS_LAYOUT_VERSION, другой версии у журнала нет.
+// Её нужно увеличивать при любом изменении списка, тогда старые записи
+// заменяются значениями по умолчанию.
+
+#include "core.h"
+#include "glyphs.h"
+
+#include <avr/pgmspace.h>
+
+#define OPTIONS_LAYOUT_VERSION 3
+
+#define JOURNAL_VERSION OPTIONS_LAYOUT_VERSION
+
+#include "journal.h"
+
+// Имя, знаки, по умолчанию, минимум, максимум
+#define OPTIONS(X)                                                            \
+  X(fan_work_duration, C, P, 10, 5, 95)  /* CP - продувка: работа, с */      \
+  X(fan_pause_duration, P, P, 3, 1, 99)  /* PP - продувка: перерыв, мин */   \
+  X(fan_speed, O, b, 99, 30, 99)         /* Ob - обороты вентилятора */      \
+  X(fan_power_during_ventilation, O, P, 90, 30, 99) /* OP - при продувке */  \
+  X(pump_connection_temperature, t, P, 40, 25, 70)  /* TP - насос ЦО */      \
+  X(hysteresis, H, I, 3, 1, 9)           /* HI - гистерезис */               \
+  X(fan_power_reduction, t, O, 5, 0, 10) /* TO - уменьшение продувки */      \
+  X(controller_shutdown_temperature, t, U, 30, 25, 50) /* TU - отключение */ \
+  X(sound_signal_enabled, b, U, 1, 0, 1) /* bU - звуковой сигнал */          \
+  X(control_mode, C, o, 0, 0, 2)         /* Co - CP/PP, ПИ, автонастройка */ \
+  X(factory_settings, U, F, 0, 0, 1)     /* UF - заводские настройки */      \
+  X(temp_target, Blank, Blank, 60, 35, 80) /* уставка, не в меню */          \
+  X(ow_sample, Blank, Blank, 0, 0, 255)  /* 1-Wire: выборка при чтении */    \
+  X(ow_rec, Blank, Blank, 0, 0, 255)     /* 1-Wire: восстановление */
+
+#define OPTION_ID(name, g0, g1, def, min, max)    Option_##name,
+#define OPTION_FIELD(name, g0, g1, def, min, max) u8 name;
+#define OPTION_DEF(name, g0, g1, def, min, max)                               \
+  { def, min, max, { Glyph_##g0, Glyph_##g1 } },
+
+typedef enum Option_Id {
+  OPTIONS(OPTION_ID)
+  Option_Count,
+} Option_Id;
+
+#define OPTIONS_MENU_COUNT Option_temp_target
+
+typedef union Options {
+  struct {
+    OPTIONS(OPTION_FIELD)
+  };
+
+  u8 e[Option_Count];
+} Options;
+
+typedef struct Option_Def {
+  u8 def, min, max;
+  u8 glyphs[2];
+} Option_Def;
+
+static Options options;
+
+static const Option_Def option_defs[Option_Count] PROGMEM = {
+  OPTIONS(OPTION_DEF)
+};
+
+#undef OPTION_ID
+#undef OPTION_FIELD
+#undef OPTION_DEF
+
+// Запись журнала - значения в порядке схемы
+#define OPTIONS_PAYLOAD_SIZE Option_Count
+
+// Option_Count - перечисление, препроцессору оно не видно
+_Static_assert(OPTIONS_PAYLOAD_SIZE <= JOURNAL_PAYLOAD_MAX,
+               "Options do not fit a journal slot");
+
+static inline u8
+option_min(u8 id)
+{
+  return pgm_read_byte(&option_defs[id].min);
+}
+
+static inline u8
+option_max(u8 id)
+{
+  return pgm_read_byte(&option_defs[id].max);
+}
+
+static inline u8
+option_glyph(u8 id, u8 pos)
+{
+  return pgm_read_byte(&option_defs[id].glyphs[pos]);
+}
+
+static inline void
+option_set(u8 id, i16 value)
+{
+  options.e[id] = CLAMP(value, option_min(id), option_max(id));
+}
+
+static inline void
+option_step(u8 id, i8 delta)
+{
+  option_set(id, (i16)options.e[id] + delta);
+}
+
+static inline void
+options_reset(void)
+{
+  u8 i;
+
+  for (i = 0; i < Option_Count; i++) {
+    options.e[i] = pgm_read_byte(&option_defs[i].def);
+  }
+}
+
+static inline void
+options_pack(u8 *payload)
+{
+  memcpy(payload, options.e, OPTIONS_PAYLOAD_SIZE);
+}
+
+// Значения вне пределов схемы приводятся к ближайшему пределу
+static inline void
+options_unpack(const u8 *payload)
+{
+  u8 i;
+
+  for (i = 0; i < Option_Count; i++) {
+    option_set(i, payload[i]);
+  }
+}
+
+#endif
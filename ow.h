@@ -0,0 +1,518 @@
+#ifndef OW_H
+#define OW_H
+
+// Неблокирующий драйвер шины 1-Wire.
+//
+// Транзакция (сброс, запись tx_len байт, чтение rx_len байт) выполняется в
+// фоне: ow_step() вызывается из прерывания системного тика и за один вызов
+// делает одну фазу сброса или до OW_BITS_PER_STEP временных слотов. Главный
+// цикл только запускает транзакцию и забирает готовый результат; ow_step()
+// сообщает о её завершении, чтобы ждущую задачу можно было разбудить сразу.
+//
+// Транзакция ow_begin_poll() после записи читает по одному слоту за тик, пока
+// устройство не ответит единицей, например до окончания преобразования.
+//
+// ow_begin_search() выполняет один проход Search ROM (Maxim AN187): по одной
+// тройке слотов (бит, дополнение, направление) за тик. Повторные проходы
+// перечисляют все устройства, пока ow_search_done() не вернёт true.
+//
+// Выборка при чтении и восстановление после слота идут по задержкам из
+// ow_timing. ow_begin_calibrate() после сброса меряет таймером 0 цену прохода
+// цикла задержки и время нарастания линии в слотах записи 1 и выставляет
+// самые короткие задержки с запасом ow_timing.margin. ow_timing_relax()
+// увеличивает запас, если на шине появились ошибки.
+//
+// Перед подключением должны быть определены PIN_OW, PIN_OW_READ, PIN_OW_DDR и
+// PIN_OW_PORT.
+
+#include "core.h"
+#include "crc8.h"
+
+#include <util/delay_basic.h>
+
+// Слотов за один тик. Каждый слот занимает около 70 мкс внутри прерывания
+#ifndef OW_BITS_PER_STEP
+#define OW_BITS_PER_STEP 2
+#endif
+
+// Match ROM + код + команда
+#define OW_BUFFER_MAX 10
+#define OW_ROM_SIZE   8
+
+#define OW_CMD_SEARCH_ROM 0xF0
+#define OW_CMD_MATCH_ROM  0x55
+#define OW_CMD_SKIP_ROM   0xCC
+
+// Временные параметры слотов, мкс
+#define OW_T_PRESENCE   70 // от отпускания линии до чтения импульса присутствия
+#define OW_T_LOW_1      5  // запись 1: линия прижата
+#define OW_T_LOW_0      60 // запись 0: линия прижата
+#define OW_T_REC        5  // восстановление после записи 0
+#define OW_T_READ_LOW   2  // чтение: линия прижата
+#define OW_T_SAMPLE     8  // чтение: от отпускания до выборки
+#define OW_T_SLOT       60 // остаток слота после записи 1 и после выборки
+#define OW_T_READ_MAX   15 // выборка не позже 15 мкс от начала слота
+
+// Задержка в проходах _delay_loop_1 (3 такта), не меньше одного
+#define OW_LOOPS(us)                                                          \
+  ((us) * (F_CPU / 1000000UL) >= 3 ? ((us) * (F_CPU / 1000000UL) + 2) / 3 : 1)
+
+// Тактов слота чтения сверх OW_T_READ_LOW и проходов цикла задержки, по
+// командам ow_read_slot(): отпускание линии (cbi, 2), загрузка
+// ow_timing.sample (lds, 2), выход из цикла (-1), чтение PIN (sbic, до 2) и
+// такт на пересылку счётчика
+#define OW_SAMPLE_OVERHEAD 6
+
+// Предел ow_timing.sample и ow_timing.rec в проходах. Отсчитывается от начала
+// слота и округляется вниз, чтобы выборка не ушла за OW_T_READ_MAX
+#define OW_READ_CYCLES ((OW_T_READ_MAX - OW_T_READ_LOW) * (F_CPU / 1000000UL))
+#define OW_SAMPLE_MAX                                                         \
+  (OW_READ_CYCLES >= OW_SAMPLE_OVERHEAD + 3                                   \
+       ? (OW_READ_CYCLES - OW_SAMPLE_OVERHEAD) / 3                            \
+       : 1)
+
+// Калибровка: слотов для замера нарастания, проходов для замера цикла и
+// предел ожидания линии в тактах
+#define OW_CAL_SLOTS    8
+#define OW_CAL_LOOPS    16
+#define OW_CAL_RISE_MAX 200
+
+typedef enum Ow_State {
+  Ow_State_Idle = 0,
+  Ow_State_Reset,
+  Ow_State_Presence,
+  Ow_State_Write,
+  Ow_State_Read,
+  Ow_State_Poll,
+  Ow_State_Search,
+  Ow_State_Calibrate,
+} Ow_State;
+
+typedef enum Ow_Result {
+  Ow_Result_Ok = 0,
+  Ow_Result_Busy,
+  Ow_Result_No_Presence,
+  Ow_Result_Short,     // линия прижата к земле или не поднимается
+  Ow_Result_Timeout,   // устройство не ответило единицей за отведённое время
+  Ow_Result_No_Device, // при поиске оба бита равны 1
+} Ow_Result;
+
+typedef struct Ow_Bus {
+  u8   state, result;
+  bool present;
+  u8   tx_len, rx_len, pos, bit;
+  u16  poll_left; // тиков до таймаута опроса, 0 - без опроса
+  u8   buffer[OW_BUFFER_MAX];
+
+  // Поиск: код последнего найденного устройства и позиции расхождений
+  bool search;
+  u8   rom[OW_ROM_SIZE];
+  u8   search_last, search_zero;
+
+  bool calibrate;
+} Ow_Bus;
+
+// Задержки слотов в проходах _delay_loop_1
+typedef struct Ow_Timing {
+  u8   sample;     // чтение: от отпускания линии до выборки
+  u8   rec;        // восстановление после слота записи 0
+  u8   margin;     // запас сверх замеренного нарастания
+  u8   rise;       // последнее замеренное нарастание, такты
+  bool calibrated; // задержки получены калибровкой или загружены
+} Ow_Timing;
+
+static volatile Ow_Bus ow_bus;
+
+static Ow_Timing ow_timing = {
+  .sample = CLAMP_TOP(OW_LOOPS(OW_T_SAMPLE), OW_SAMPLE_MAX),
+  .rec    = OW_LOOPS(OW_T_REC),
+  .margin = 1,
+};
+
+static inline bool
+ow_busy(void)
+{
+  return ow_bus.state != Ow_State_Idle;
+}
+
+// Результат последней транзакции
+static inline Ow_Result
+ow_result(void)
+{
+  return ow_bus.result;
+}
+
+// Прочитанные байты последней транзакции
+static inline u8
+ow_data(u8 idx)
+{
+  return ow_bus.buffer[idx];
+}
+
+static inline bool
+ow_start(const u8 *tx, u8 tx_len, u8 rx_len, u16 poll)
+{
+  u8 i;
+
+  if (ow_busy() || tx_len > OW_BUFFER_MAX || rx_len > OW_BUFFER_MAX) {
+    return false;
+  }
+
+  for (i = 0; i < tx_len; i++) {
+    ow_bus.buffer[i] = tx[i];
+  }
+
+  ow_bus.tx_len    = tx_len;
+  ow_bus.rx_len    = rx_len;
+  ow_bus.poll_left = poll;
+  ow_bus.search    = false;
+  ow_bus.calibrate = false;
+  ow_bus.pos       = 0;
+  ow_bus.bit       = 0;
+  ow_bus.result    = Ow_Result_Busy;
+
+  // Запись состояния последней - с этого момента транзакцию видит прерывание
+  ow_bus.state = Ow_State_Reset;
+
+  return true;
+}
+
+// Запуск транзакции. Возвращает false, если шина занята
+static inline bool
+ow_begin(const u8 *tx, u8 tx_len, u8 rx_len)
+{
+  return ow_start(tx, tx_len, rx_len, 0);
+}
+
+// Запуск транзакции с опросом после записи: не дольше timeout тиков
+static inline bool
+ow_begin_poll(const u8 *tx, u8 tx_len, u16 timeout)
+{
+  return ow_start(tx, tx_len, 0, timeout ? timeout : 1);
+}
+
+// Начать перечисление устройств заново
+static inline void
+ow_search_reset(void)
+{
+  u8 i;
+
+  for (i = 0; i < OW_ROM_SIZE; i++) {
+    ow_bus.rom[i] = 0;
+  }
+  ow_bus.search_last = 0;
+}
+
+// Один проход поиска, найденный код читается через ow_search_rom()
+static inline bool
+ow_begin_search(void)
+{
+  static const u8 cmd[] = { OW_CMD_SEARCH_ROM };
+
+  if (!ow_start(cmd, sizeof(cmd), 0, 0)) {
+    return false;
+  }
+
+  ow_bus.search_zero = 0;
+  ow_bus.search      = true;
+
+  return true;
+}
+
+// Калибровка задержек: сброс и OW_CAL_SLOTS слотов записи 1
+static inline bool
+ow_begin_calibrate(void)
+{
+  if (!ow_start(0, 0, 0, 0)) {
+    return false;
+  }
+
+  ow_bus.calibrate = true;
+
+  return true;
+}
+
+// Добавить запас к задержкам. Возвращает false, если запас уже предельный
+static inline bool
+ow_timing_relax(void)
+{
+  if (ow_timing.sample >= OW_SAMPLE_MAX) {
+    return false;
+  }
+
+  ow_timing.margin += 1;
+  ow_timing.sample += 1;
+  ow_timing.rec += 1;
+
+  return true;
+}
+
+static inline u8
+ow_search_rom(u8 idx)
+{
+  return ow_bus.rom[idx];
+}
+
+// Найдено последнее устройство на шине
+static inline bool
+ow_search_done(void)
+{
+  return ow_bus.search_last == 0;
+}
+
+static inline void
+ow_finish(Ow_Result result)
+{
+  ow_bus.result = result;
+  ow_bus.state  = Ow_State_Idle;
+}
+
+// Временные слоты. Вызываются из прерывания, поэтому уже атомарны
+
+static inline void
+ow_write_slot(u8 bit)
+{
+  gpio_set_mode_output(&PIN_OW_DDR, PIN_OW);
+
+  if (bit) {
+    _delay_us(OW_T_LOW_1);
+    gpio_set_mode_input(&PIN_OW_DDR, PIN_OW);
+    _delay_us(OW_T_SLOT);
+  } else {
+    _delay_us(OW_T_LOW_0);
+    gpio_set_mode_input(&PIN_OW_DDR, PIN_OW);
+    _delay_loop_1(ow_timing.rec);
+  }
+}
+
+static inline u8
+ow_read_slot(void)
+{
+  u8 res = 0;
+
+  gpio_set_mode_output(&PIN_OW_DDR, PIN_OW);
+  _delay_us(OW_T_READ_LOW);
+  gpio_set_mode_input(&PIN_OW_DDR, PIN_OW);
+  _delay_loop_1(ow_timing.sample);
+  res = gpio_read(&PIN_OW_READ, PIN_OW);
+  _delay_us(OW_T_SLOT);
+
+  return res;
+}
+
+// Замер таймером 0 без предделителя, отсчёт - один такт. Таймер 0 ведёт часы
+// планировщика, поэтому его настройка и счёт восстанавливаются, а
+// переполнение от замера сбрасывается
+static inline bool
+ow_calibrate(void)
+{
+  u8   tccr = TCCR0;
+  u8   tcnt = TCNT0;
+  u8   tov  = TIFR & (1 << TOV0);
+  u8   loop = 0, rise = 0, i = 0, n = 0;
+  bool ok   = true;
+  u16  sample;
+
+  TCCR0 = (1 << CS00);
+
+  // Цена прохода цикла задержки вместе с вызовом
+  TCNT0 = 0;
+  _delay_loop_1(OW_CAL_LOOPS);
+  loop = TCNT0;
+
+  // Нарастание линии после отпускания в слотах записи 1. Устройства после
+  // сброса принимают их как команду 0xFF и ждут следующего сброса
+  for (i = 0; i < OW_CAL_SLOTS; i++) {
+    gpio_set_mode_output(&PIN_OW_DDR, PIN_OW);
+    _delay_us(OW_T_LOW_1);
+    TCNT0 = 0;
+    gpio_set_mode_input(&PIN_OW_DDR, PIN_OW);
+
+    n = 0;
+    while (!gpio_read(&PIN_OW_READ, PIN_OW) && TCNT0 < OW_CAL_RISE_MAX
+           && ++n < OW_CAL_RISE_MAX) {
+    }
+
+    if (TCNT0 >= OW_CAL_RISE_MAX || n >= OW_CAL_RISE_MAX) {
+      ok = false;
+    } else if (TCNT0 > rise) {
+      rise = TCNT0;
+    }
+
+    _delay_us(OW_T_SLOT);
+  }
+
+  TCCR0 = tccr;
+  TCNT0 = tcnt;
+  if (!tov) {
+    TIFR = (1 << TOV0);
+  }
+
+  if (!ok) {
+    return false;
+  }
+
+  // Таймер не идёт (стенд на хосте) - номинальная цена прохода
+  if (loop < OW_CAL_LOOPS * 3) {
+    loop = OW_CAL_LOOPS * 3;
+  }
+
+  // Такты нарастания в проходы цикла с округлением вверх
+  sample = ((u16)rise * OW_CAL_LOOPS + loop - 1) / loop + ow_timing.margin;
+  sample = CLAMP(sample, 1, OW_SAMPLE_MAX);
+
+  ow_timing.rise       = rise;
+  ow_timing.sample     = sample;
+  ow_timing.rec        = sample;
+  ow_timing.calibrated = true;
+
+  return true;
+}
+
+// Шаг конечного автомата, вызывается из прерывания системного тика.
+// Возвращает true, если на этом шаге транзакция завершилась
+static bool
+ow_step(void)
+{
+  bool busy = ow_busy();
+  u8   n    = 0;
+
+  switch (ow_bus.state) {
+  case Ow_State_Reset: {
+    // Подтяжка должна держать линию в 1, иначе линия замкнута
+    if (!gpio_read(&PIN_OW_READ, PIN_OW)) {
+      ow_bus.present = false;
+      ow_finish(Ow_Result_Short);
+      break;
+    }
+
+    // Импульс сброса длится до следующего тика (не менее 480 мкс)
+    gpio_write_low(&PIN_OW_PORT, PIN_OW);
+    gpio_set_mode_output(&PIN_OW_DDR, PIN_OW);
+    ow_bus.state = Ow_State_Presence;
+  } break;
+
+  case Ow_State_Presence: {
+    gpio_set_mode_input(&PIN_OW_DDR, PIN_OW);
+    _delay_us(OW_T_PRESENCE);
+    ow_bus.present = !gpio_read(&PIN_OW_READ, PIN_OW);
+
+    if (!ow_bus.present) {
+      ow_finish(Ow_Result_No_Presence);
+    } else if (ow_bus.calibrate) {
+      ow_bus.state = Ow_State_Calibrate;
+    } else if (ow_bus.tx_len) {
+      ow_bus.state = Ow_State_Write;
+    } else if (ow_bus.rx_len) {
+      ow_bus.state = Ow_State_Read;
+    } else {
+      ow_finish(Ow_Result_Ok);
+    }
+  } break;
+
+  case Ow_State_Write: {
+    for (n = OW_BITS_PER_STEP; n; n--) {
+      ow_write_slot(ow_bus.buffer[ow_bus.pos] & (1 << ow_bus.bit));
+
+      if (++ow_bus.bit < 8) {
+        continue;
+      }
+
+      ow_bus.bit = 0;
+      if (++ow_bus.pos == ow_bus.tx_len) {
+        ow_bus.pos = 0;
+        if (ow_bus.search) {
+          ow_bus.state = Ow_State_Search;
+        } else if (ow_bus.poll_left) {
+          ow_bus.state = Ow_State_Poll;
+        } else if (ow_bus.rx_len) {
+          ow_bus.state = Ow_State_Read;
+        } else {
+          ow_finish(Ow_Result_Ok);
+        }
+        break;
+      }
+    }
+  } break;
+
+  case Ow_State_Read: {
+    for (n = OW_BITS_PER_STEP; n; n--) {
+      u8 b = ow_bus.bit ? ow_bus.buffer[ow_bus.pos] >> 1 : 0;
+
+      if (ow_read_slot()) {
+        b |= 0x80;
+      }
+      ow_bus.buffer[ow_bus.pos] = b;
+
+      if (++ow_bus.bit < 8) {
+        continue;
+      }
+
+      ow_bus.bit = 0;
+      if (++ow_bus.pos == ow_bus.rx_len) {
+        ow_finish(Ow_Result_Ok);
+        break;
+      }
+    }
+  } break;
+
+  case Ow_State_Poll: {
+    if (ow_read_slot()) {
+      ow_finish(Ow_Result_Ok);
+    } else if (--ow_bus.poll_left == 0) {
+      ow_finish(Ow_Result_Timeout);
+    }
+  } break;
+
+  case Ow_State_Search: {
+    u8 id   = ow_read_slot() != 0;
+    u8 cmp  = ow_read_slot() != 0;
+    u8 n    = ow_bus.pos + 1; // номер бита 1..64, как в AN187
+    u8 mask = 1 << (ow_bus.pos & 7);
+    u8 dir  = 0;
+
+    if (id && cmp) {
+      ow_finish(Ow_Result_No_Device);
+      break;
+    }
+
+    if (id != cmp) {
+      dir = id;
+    } else {
+      // Расхождение: до последнего - как в прошлый раз, на нём - 1
+      if (n < ow_bus.search_last) {
+        dir = (ow_bus.rom[ow_bus.pos >> 3] & mask) != 0;
+      } else {
+        dir = n == ow_bus.search_last;
+      }
+
+      if (!dir) {
+        ow_bus.search_zero = n;
+      }
+    }
+
+    if (dir) {
+      ow_bus.rom[ow_bus.pos >> 3] |= mask;
+    } else {
+      ow_bus.rom[ow_bus.pos >> 3] &= ~mask;
+    }
+    ow_write_slot(dir);
+
+    if (++ow_bus.pos == OW_ROM_SIZE * 8) {
+      ow_bus.search_last = ow_bus.search_zero;
+      ow_finish(Ow_Result_Ok);
+    }
+  } break;
+
+  case Ow_State_Calibrate: {
+    ow_finish(ow_calibrate() ? Ow_Result_Ok : Ow_Result_Short);
+  } break;
+
+  default:
+    break;
+  }
+
+  return busy && !ow_busy();
+}
+
+#endif
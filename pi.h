@@ -0,0 +1,88 @@
+#ifndef PI_H
+#define PI_H
+
+// ПИ-регулятор мощности вентилятора по температуре.
+//
+// Вход - ошибка уставка минус температура в Q12.4, выход - скважность в
+// промилле 0..out_max. Всё целочисленное, без делений и циклов, поэтому
+// pi_update() выполняется за постоянное время.
+//
+// Интеграл накапливается как ошибка, умноженная на время с прошлого отсчёта,
+// поэтому неравные промежутки между чтениями датчика не искажают его.
+// Защита от насыщения: пока выход упёрся в предел, интеграл в сторону
+// предела не растёт, и сам интеграл не выходит за 0..out_max.
+
+#include "core.h"
+#include "temp.h"
+
+// Пропорциональный коэффициент, промилле на °C
+#ifndef PI_KP
+#define PI_KP 100
+#endif
+
+// Время интегрирования, с
+#ifndef PI_TI_S
+#define PI_TI_S 240
+#endif
+
+// Ошибка ограничивается, чтобы произведения помещались в 32 бита, °C
+#define PI_ERROR_MAX_DEG 20
+#define PI_ERROR_MAX     TEMP(PI_ERROR_MAX_DEG)
+
+// Промежуток между отсчётами, дольше которого интеграл не копится, мс
+#define PI_DT_MAX 1000
+
+// Интеграл хранится в промилле Q20. Прирост за отсчёт -
+// ошибка (1/16 °C) * время (мс) * PI_KI
+#define PI_I_SHIFT 20
+#define PI_KI                                                                 \
+  (PI_KP * (1UL << PI_I_SHIFT) / (TEMP_ONE * 1000UL * PI_TI_S))
+
+#if PI_KI < 1
+#error "PI_TI_S is too long for the integral resolution"
+#endif
+
+#if PI_KI * PI_DT_MAX * PI_ERROR_MAX_DEG * TEMP_ONE > 0x7FFFFFFF
+#error "PI_KP / PI_TI_S overflow the integral step"
+#endif
+
+typedef struct Pi {
+  i32  integral; // промилле Q20
+  u32  last;     // тик предыдущего отсчёта
+  bool started;
+} Pi;
+
+static inline void
+pi_reset(Pi *self)
+{
+  self->integral = 0;
+  self->started  = false;
+}
+
+// Новый отсчёт. Возвращает скважность в промилле
+static inline u16
+pi_update(Pi *self, Temp error, u16 out_max, u32 now_ticks)
+{
+  i32 limit = (i32)out_max << PI_I_SHIFT;
+  u32 dt    = self->started ? now_ticks - self->last : 0;
+  i32 out   = 0;
+
+  self->last    = now_ticks;
+  self->started = true;
+
+  error = CLAMP(error, -PI_ERROR_MAX, PI_ERROR_MAX);
+  dt    = CLAMP_TOP(dt, PI_DT_MAX);
+
+  out = (((i32)error * PI_KP) >> TEMP_FRAC_BITS)
+        + (self->integral >> PI_I_SHIFT);
+
+  // Интеграл не копится в сторону насыщенного выхода
+  if (!(out >= out_max && error > 0) && !(out <= 0 && error < 0)) {
+    self->integral += (i32)error * (i32)dt * (i32)PI_KI;
+    self->integral = CLAMP(self->integral, 0, limit);
+  }
+
+  return CLAMP(out, 0, (i32)out_max);
+}
+
+#endif
@@ -0,0 +1,77 @@
+#ifndef PWM_H
+#define PWM_H
+
+// ШИМ на выводе OC1A таймера 1.
+//
+// Период задаётся TOP в ICR1, поэтому частоту можно выбрать любую, а не
+// только F_CPU / 256 / предделитель. pwm_init() включает частоту, режим,
+// предделитель и TOP, посчитанные в timing.h при сборке.
+//
+// Скважность задаётся в промилле 0..PWM_PERMILLE_MAX и переводится в OCR1A
+// умножением на заранее посчитанный масштаб, без деления. На нулевой
+// скважности выход отключается от вывода: в режиме Fast OCR1A = 0 всё равно
+// даёт короткий импульс в каждом периоде.
+
+#include "core.h"
+#include "timing.h"
+
+#include <util/atomic.h>
+
+#define PWM_PERMILLE_MAX 1000
+
+typedef enum Pwm_Mode {
+  Pwm_Mode_Fast = 0,     // WGM 14, частота F_CPU / (N * (TOP + 1))
+  Pwm_Mode_Phase_Correct // WGM 10, частота F_CPU / (2 * N * TOP)
+} Pwm_Mode;
+
+static u16 pwm_top;
+static u32 pwm_scale;    // (TOP + 1) / 1000 в формате Q16
+static u16 pwm_permille; // текущая скважность
+
+// Скважность в промилле. Вызывается из прерывания или с запрещёнными
+// прерываниями: OCR1A 16-битный
+static inline void
+pwm_set(u16 permille)
+{
+  pwm_permille = permille;
+
+  if (permille == 0) {
+    TCCR1A &= ~(1 << COM1A1);
+    OCR1A = 0;
+    return;
+  }
+
+  OCR1A = permille >= PWM_PERMILLE_MAX ? pwm_top
+                                       : (u16)((permille * pwm_scale) >> 16);
+  TCCR1A |= (1 << COM1A1);
+}
+
+static inline void
+pwm_apply(Pwm_Mode mode, u8 cs, u16 top)
+{
+  u32 scale = ((u32)top + 1) * 65536UL / PWM_PERMILLE_MAX;
+
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    pwm_top   = top;
+    pwm_scale = scale;
+
+    TCCR1B = 0;
+    TCNT1  = 0;
+    ICR1   = top;
+    TCCR1A = (TCCR1A & (1 << COM1A1)) | (1 << WGM11);
+    pwm_set(pwm_permille);
+    TCCR1B = (1 << WGM13) | (mode == Pwm_Mode_Fast ? (1 << WGM12) : 0) | cs;
+  }
+}
+
+// Частота и режим из timing.h, скважность 0
+static inline void
+pwm_init(void)
+{
+  pwm_permille = 0;
+  pwm_apply(TIMING_PWM_PHASE_CORRECT ? Pwm_Mode_Phase_Correct : Pwm_Mode_Fast,
+            TIMING_TIMER1_CS, TIMING_TIMER1_TOP);
+}
+
+#endif
@@ -0,0 +1,146 @@
+#ifndef SCHED_H
+#define SCHED_H
+
+// Кооперативный планировщик задач главного цикла.
+//
+// Задача - функция с периодом в тиках и приоритетом (0 - высший). За проход
+// sched_run() обходит задачи в порядке приоритета и запускает те, у которых
+// истёк период или которые были отмечены sched_signal(). Период 0 - задача
+// запускается только по сигналу.
+//
+// Для каждой задачи считается число запусков и худшее время выполнения в
+// отсчётах SCHED_CLOCK(). На плате отсчёт таймера 0 длится
+// TIMING_TIMER0_PRESCALER тактов ядра, на хосте стенд подставляет свои часы.
+
+#include "core.h"
+#include "timer.h"
+#include "timing.h"
+
+#ifndef SCHED_TASKS_MAX
+#define SCHED_TASKS_MAX 8
+#endif
+
+typedef void (*Task_Fn)(void);
+
+typedef struct Task {
+  Task_Fn       fn;
+  u16           period;
+  u8            priority;
+  volatile bool signaled; // sched_signal() вызывается и из прерываний
+  Timer         timer;
+
+  // Статистика
+  u32 runs;
+  u16 worst;
+} Task;
+
+static Task sched_tasks[SCHED_TASKS_MAX];
+static u8   sched_order[SCHED_TASKS_MAX]; // индексы задач по приоритету
+static u8   sched_count;
+
+// Старший байт часов планировщика, младший - TCNT0
+static volatile u8 sched_overflows;
+
+// Вызывается из ISR(TIMER0_OVF_vect)
+static inline void
+sched_clock_overflow(void)
+{
+  sched_overflows += 1;
+}
+
+// 16-битные часы с разрешением в один отсчёт таймера 0
+static inline u16
+sched_clock(void)
+{
+  u8 sreg = SREG;
+  u8 hi, lo;
+
+  disable_interrupts();
+  hi = sched_overflows;
+  lo = TCNT0;
+  // Переполнение, которое ещё не успели обработать
+  if ((TIFR & (1 << TOV0)) && lo < 0xFF) {
+    hi += 1;
+  }
+  SREG = sreg;
+
+  return ((u16)hi << 8) | lo;
+}
+
+#ifndef SCHED_CLOCK
+#define SCHED_CLOCK() sched_clock()
+#endif
+
+// Регистрация задачи. Возвращает её номер для sched_signal() и статистики
+static inline u8
+sched_add(Task_Fn fn, u16 period, u8 priority)
+{
+  u8 id = sched_count;
+  u8 i  = id;
+
+  if (id >= SCHED_TASKS_MAX) {
+    return UINT8_MAX;
+  }
+
+  sched_tasks[id] = (Task){ .fn = fn, .period = period, .priority = priority };
+
+  // Вставка в порядок обхода, задачи с равным приоритетом - в порядке
+  // регистрации
+  while (i && sched_tasks[sched_order[i - 1]].priority > priority) {
+    sched_order[i] = sched_order[i - 1];
+    i -= 1;
+  }
+  sched_order[i] = id;
+
+  sched_count += 1;
+
+  return id;
+}
+
+// Запустить задачу на ближайшем проходе
+static inline void
+sched_signal(u8 id)
+{
+  if (id < sched_count) {
+    sched_tasks[id].signaled = true;
+  }
+}
+
+static inline const Task *
+sched_task(u8 id)
+{
+  return &sched_tasks[id];
+}
+
+// Один проход главного цикла
+static inline void
+sched_run(u32 now_ticks)
+{
+  u8 i;
+
+  timers_update(now_ticks);
+
+  for (i = 0; i < sched_count; i++) {
+    Task *task = &sched_tasks[sched_order[i]];
+    u16   start, elapsed;
+
+    // Опрос таймера нужен и для сигнальных задач, чтобы он не отставал
+    if (!(task->period && timer_every(&task->timer, task->period, now_ticks))
+        && !task->signaled) {
+      continue;
+    }
+
+    task->signaled = false;
+
+    start = SCHED_CLOCK();
+    task->fn();
+    elapsed = SCHED_CLOCK() - start;
+
+    task->runs += 1;
+    if (elapsed > task->worst) {
+      task->worst = elapsed;
+    }
+  }
+}
+
+#endif
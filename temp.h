@@ -0,0 +1,31 @@
+#ifndef TEMP_H
+#define TEMP_H
+
+// Температура в формате Q12.4: знаковое 16-битное значение в 1/16 °C, как в
+// регистре температуры DS18B20. Все преобразования целочисленные.
+
+#include "builtin.h"
+
+typedef i16 Temp;
+
+#define TEMP_FRAC_BITS 4
+#define TEMP_ONE       (1 << TEMP_FRAC_BITS)
+
+// Целые градусы в Q12.4, для констант и значений настроек
+#define TEMP(deg) ((Temp)((i16)(deg) * TEMP_ONE))
+
+// Значение из младшего и старшего байта скретчпада DS18B20
+static inline Temp
+temp_from_scratchpad(u8 lsb, u8 msb)
+{
+  return (Temp)(((u16)msb << 8) | lsb);
+}
+
+// Округление до ближайших целых градусов
+static inline i16
+temp_to_int(Temp value)
+{
+  return (value + TEMP_ONE / 2) >> TEMP_FRAC_BITS;
+}
+
+#endif
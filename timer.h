@@ -0,0 +1,275 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+// Служба программных таймеров.
+//
+// Таймер занимает 5 байт: ссылка, 16-битный срок и флаги. Срок считается в
+// единицах таймера: тиках, 10 мс или секундах, единица задаётся при
+// объявлении через TIMER_UNIT(). Задержки во всех функциях передаются в
+// тиках, как раньше.
+//
+// Взведённые таймеры хранятся в односвязных списках по единицам,
+// упорядоченных по сроку срабатывания. timers_update() раз за проход главного
+// цикла сравнивает со временем только головы списков и помечает истёкшие
+// таймеры флагом due. Опрос таймера (timer_duty, timer_once, timer_every) -
+// это проверка фазы и флага, сравнения сроков делает только служба.
+//
+// Таймер взводится первым опросом и останавливается timer_stop(), как
+// Timer32 с timer_reset(). Сроки сравниваются разностью со знаком, поэтому
+// переполнение счётчиков таймерам не мешает.
+
+#include "core.h"
+
+typedef enum Timer_Phase {
+  Timer_Phase_Idle = 0, // не взведён
+  Timer_Phase_Wait,     // начальная задержка
+  Timer_Phase_Work,     // рабочая часть цикла
+  Timer_Phase_Sleep,    // пауза цикла
+  Timer_Phase_Done,     // одноразовый таймер истёк
+} Timer_Phase;
+
+// Единица срока. Срок хранится в 16 битах и сравнивается со знаком, поэтому
+// задержка не длиннее 32767 единиц
+typedef enum Timer_Unit {
+  Timer_Unit_Tick = 0, // 1 мс, до 32 с
+  Timer_Unit_10ms,     // до 5 мин
+  Timer_Unit_Second,   // до 9 ч
+  Timer_Unit_Count,
+} Timer_Unit;
+
+// Таймер с крупной единицей: static Timer t = TIMER_UNIT(Timer_Unit_Second);
+#define TIMER_UNIT(value) { .unit = (value) }
+
+typedef struct Timer {
+  struct Timer *next;
+  u16           deadline; // в единицах unit
+  u8            phase : 3;
+  u8            due : 1;
+  u8            unit : 2;
+} Timer;
+
+static Timer *timers_heads[Timer_Unit_Count];
+
+// Время по каждой единице и тики с начала текущей единицы на момент
+// последнего timers_update()
+static u16 timers_now[Timer_Unit_Count];
+static u16 timers_frac[Timer_Unit_Count];
+static u32 timers_last;
+
+static inline u16
+timer_unit_ticks(u8 unit)
+{
+  switch (unit) {
+  case Timer_Unit_10ms:
+    return 10;
+  case Timer_Unit_Second:
+    return 1000;
+  default:
+    return 1;
+  }
+}
+
+static inline void
+timer_link(Timer *self, u16 deadline)
+{
+  Timer **it = &timers_heads[self->unit];
+
+  self->deadline = deadline;
+  self->due      = false;
+
+  while (*it && (i16)((*it)->deadline - deadline) <= 0) {
+    it = &(*it)->next;
+  }
+
+  self->next = *it;
+  *it        = self;
+}
+
+// Взвести таймер на delay тиков от now_ticks. Срок крупной единицы
+// округляется вверх, таймер не срабатывает раньше времени
+static inline void
+timer_link_delay(Timer *self, u32 delay, u32 now_ticks)
+{
+  u16 ticks = timer_unit_ticks(self->unit);
+  u32 units = 0;
+
+  if (ticks == 1) {
+    units = delay;
+    timer_link(self, (u16)(now_ticks + CLAMP_TOP(units, INT16_MAX)));
+    return;
+  }
+
+  // Тики с начала текущей единицы на момент now_ticks
+  delay += timers_frac[self->unit] + (now_ticks - timers_last);
+  units = (delay + ticks - 1) / ticks;
+
+  timer_link(self, timers_now[self->unit] + CLAMP_TOP(units, INT16_MAX));
+}
+
+static inline void
+timer_unlink(Timer *self)
+{
+  Timer **it = &timers_heads[self->unit];
+
+  while (*it) {
+    if (*it == self) {
+      *it = self->next;
+      break;
+    }
+    it = &(*it)->next;
+  }
+
+  self->next = 0;
+}
+
+// Продвинуть время единицы на delta тиков. Обычно проход главного цикла
+// короче единицы, и деление нужно только после долгой паузы
+static inline void
+timers_advance(u8 unit, u32 delta)
+{
+  u16 ticks = timer_unit_ticks(unit);
+  u32 frac  = timers_frac[unit] + delta;
+  u32 n     = 0;
+
+  if (frac >= ticks) {
+    n = frac < 2 * (u32)ticks ? 1 : frac / ticks;
+    timers_now[unit] += n;
+    frac -= n * ticks;
+  }
+
+  timers_frac[unit] = frac;
+}
+
+// Помечает истёкшие таймеры. Проверяется только голова каждого списка
+static inline void
+timers_update(u32 now_ticks)
+{
+  u32 delta = now_ticks - timers_last;
+  u8  unit  = 0;
+
+  timers_last                 = now_ticks;
+  timers_now[Timer_Unit_Tick] = (u16)now_ticks;
+  timers_advance(Timer_Unit_10ms, delta);
+  timers_advance(Timer_Unit_Second, delta);
+
+  for (unit = 0; unit < Timer_Unit_Count; unit++) {
+    Timer **head = &timers_heads[unit];
+
+    while (*head && (i16)((*head)->deadline - timers_now[unit]) <= 0) {
+      Timer *timer = *head;
+
+      *head       = timer->next;
+      timer->next = 0;
+      timer->due  = true;
+    }
+  }
+}
+
+static inline void
+timer_stop(Timer *self)
+{
+  if (self->phase == Timer_Phase_Idle) {
+    return;
+  }
+
+  if (!self->due) {
+    timer_unlink(self);
+  }
+
+  self->phase = Timer_Phase_Idle;
+  self->due   = false;
+}
+
+// Прошла ли начальная задержка таймера timer_duty
+static inline bool
+timer_wait_done(const Timer *self)
+{
+  return self->phase == Timer_Phase_Work || self->phase == Timer_Phase_Sleep;
+}
+
+// Скважностный таймер, замена timer_expired_ext: после задержки wait
+// возвращает true в течение period, затем false в течение sleep_duration и
+// так по кругу
+static inline bool
+timer_duty(Timer *self, u32 wait, u32 period, u32 sleep_duration,
+           u32 now_ticks)
+{
+  u8 inclusive = 0;
+
+  if (self->phase == Timer_Phase_Idle) {
+    self->phase = Timer_Phase_Wait;
+    timer_link_delay(self, wait, now_ticks);
+    return false;
+  }
+
+  if (!self->due) {
+    return self->phase == Timer_Phase_Work;
+  }
+
+  // Срок рабочей части и паузы включает последний тик, как в
+  // timer_expired_ext. Крупной единице лишний тик стоил бы целой единицы
+  inclusive = self->unit == Timer_Unit_Tick;
+
+  if (self->phase == Timer_Phase_Work) {
+    self->phase = Timer_Phase_Sleep;
+    timer_link_delay(self, sleep_duration + inclusive, now_ticks);
+    return false;
+  }
+
+  self->phase = Timer_Phase_Work;
+  timer_link_delay(self, period + inclusive, now_ticks);
+
+  return true;
+}
+
+// Одноразовый таймер: true после задержки delay и до timer_stop()
+static inline bool
+timer_once(Timer *self, u32 delay, u32 now_ticks)
+{
+  if (self->phase == Timer_Phase_Idle) {
+    self->phase = Timer_Phase_Wait;
+    timer_link_delay(self, delay, now_ticks);
+    return false;
+  }
+
+  if (self->due) {
+    self->due   = false;
+    self->phase = Timer_Phase_Done;
+  }
+
+  return self->phase == Timer_Phase_Done;
+}
+
+// Периодический таймер: true один раз за каждый период. Срок отсчитывается
+// от предыдущего срока, поэтому период не накапливает ошибку
+static inline bool
+timer_every(Timer *self, u32 period, u32 now_ticks)
+{
+  u16 ticks = 0, units = 0, deadline = 0;
+
+  if (self->phase == Timer_Phase_Idle) {
+    self->phase = Timer_Phase_Work;
+    timer_link_delay(self, period, now_ticks);
+    return false;
+  }
+
+  if (!self->due) {
+    return false;
+  }
+
+  ticks = timer_unit_ticks(self->unit);
+  units = ticks == 1 ? CLAMP_TOP(period, INT16_MAX)
+                     : CLAMP_TOP((period + ticks - 1) / ticks, INT16_MAX);
+
+  // Если цикл отстал больше чем на период, отсчёт начинается заново
+  deadline = self->deadline + units;
+  if ((i16)(deadline - timers_now[self->unit]) <= 0) {
+    timer_link_delay(self, period, now_ticks);
+  } else {
+    timer_link(self, deadline);
+  }
+
+  return true;
+}
+
+#endif
@@ -0,0 +1,164 @@
+#ifndef TIMING_H
+#define TIMING_H
+
+// Настройки аппаратных таймеров, выведенные из F_CPU.
+//
+// Таймер 2 (CTC) - системный тик 1 мс, таймер 0 (переполнение) - часы
+// планировщика и обновление индикатора, таймер 1 (TOP в ICR1) - ШИМ
+// вентилятора. Для каждого выбирается предделитель, при котором период
+// ближе всего к заданному, и проверяется, что значения помещаются в регистры.
+
+#include "builtin.h"
+
+#include <avr/io.h>
+
+#ifndef F_CPU
+#error "F_CPU is not defined"
+#endif
+
+// Системный тик, Гц
+#define TIMING_TICK_HZ 1000UL
+
+// Период переключения разрядов индикатора, мкс
+#define TIMING_DISPLAY_US 8000UL
+
+// Наибольшая частота ШИМ вентилятора по умолчанию, Гц
+#define TIMING_PWM_HZ_MAX 20000UL
+
+// Таймер 2: наименьший предделитель, при котором OCR2 с поправкой помещается
+// в 8 бит. Предделители 1, 8, 32, 64, 128, 256
+#define TIMING_TICK_CYCLES (F_CPU / TIMING_TICK_HZ)
+
+#if TIMING_TICK_CYCLES < 256
+#define TIMING_TIMER2_PRESCALER 1
+#define TIMING_TIMER2_CS        (1 << CS20)
+#elif TIMING_TICK_CYCLES < 256UL * 8
+#define TIMING_TIMER2_PRESCALER 8
+#define TIMING_TIMER2_CS        (1 << CS21)
+#elif TIMING_TICK_CYCLES < 256UL * 32
+#define TIMING_TIMER2_PRESCALER 32
+#define TIMING_TIMER2_CS        ((1 << CS21) | (1 << CS20))
+#elif TIMING_TICK_CYCLES < 256UL * 64
+#define TIMING_TIMER2_PRESCALER 64
+#define TIMING_TIMER2_CS        (1 << CS22)
+#elif TIMING_TICK_CYCLES < 256UL * 128
+#define TIMING_TIMER2_PRESCALER 128
+#define TIMING_TIMER2_CS        ((1 << CS22) | (1 << CS20))
+#elif TIMING_TICK_CYCLES < 256UL * 256
+#define TIMING_TIMER2_PRESCALER 256
+#define TIMING_TIMER2_CS        ((1 << CS22) | (1 << CS21))
+#else
+#error "F_CPU is too high for a 1 ms tick on timer 2"
+#endif
+
+// Период тика в отсчётах таймера 2: целая часть и остаток дроби
+// F_CPU / (предделитель * TIMING_TICK_HZ)
+#define TIMING_TICK_DEN    (TIMING_TIMER2_PRESCALER * TIMING_TICK_HZ)
+#define TIMING_TICK_COUNTS (F_CPU / TIMING_TICK_DEN)
+#define TIMING_TICK_FRAC   (F_CPU % TIMING_TICK_DEN)
+
+#define TIMING_TIMER2_OCR (TIMING_TICK_COUNTS - 1)
+
+// Таймер 0: наименьший предделитель, при котором переполнение не чаще
+// одного раза за тик. Предделители 1, 8, 64, 256, 1024
+#if 256UL * 1 >= TIMING_TICK_CYCLES
+#define TIMING_TIMER0_PRESCALER 1
+#define TIMING_TIMER0_CS        (1 << CS00)
+#elif 256UL * 8 >= TIMING_TICK_CYCLES
+#define TIMING_TIMER0_PRESCALER 8
+#define TIMING_TIMER0_CS        (1 << CS01)
+#elif 256UL * 64 >= TIMING_TICK_CYCLES
+#define TIMING_TIMER0_PRESCALER 64
+#define TIMING_TIMER0_CS        ((1 << CS01) | (1 << CS00))
+#else
+#define TIMING_TIMER0_PRESCALER 256
+#define TIMING_TIMER0_CS        (1 << CS02)
+#endif
+
+// Период переполнения таймера 0, мкс
+#define TIMING_TIMER0_OVF_US                                                  \
+  (256UL * TIMING_TIMER0_PRESCALER / (F_CPU / 1000000UL))
+
+// Переполнений на один разряд индикатора, не меньше одного
+#if TIMING_DISPLAY_US < TIMING_TIMER0_OVF_US * 3 / 2
+#define TIMING_DISPLAY_DIV 1
+#else
+#define TIMING_DISPLAY_DIV                                                    \
+  ((TIMING_DISPLAY_US + TIMING_TIMER0_OVF_US / 2) / TIMING_TIMER0_OVF_US)
+#endif
+
+// Таймер 1 - ШИМ вентилятора с TOP в ICR1. Частота по умолчанию - не выше
+// TIMING_PWM_HZ_MAX, но так, чтобы в периоде было не меньше
+// TIMING_PWM_STEPS_MIN ступеней: по ступени на процент мощности из настроек.
+// За пределы слышимого ШИМ уходит только с 2 МГц. На 1 МГц разрешение
+// важнее, и частота - 10 кГц; -DTIMING_PWM_HZ=20000 даст 20 кГц ценой 50
+// ступеней, когда соседние проценты мощности попарно совпадут.
+// TIMING_PWM_PHASE_CORRECT = 1 выбирает режим Phase Correct: частота при том
+// же TOP вдвое ниже, фронты симметричны
+#ifndef TIMING_PWM_PHASE_CORRECT
+#define TIMING_PWM_PHASE_CORRECT 0
+#endif
+
+#define TIMING_PWM_STEPS_MIN 100UL
+
+#ifndef TIMING_PWM_HZ
+#if F_CPU / TIMING_PWM_STEPS_MIN / (TIMING_PWM_PHASE_CORRECT + 1)             \
+    < TIMING_PWM_HZ_MAX
+#define TIMING_PWM_HZ                                                         \
+  (F_CPU / TIMING_PWM_STEPS_MIN / (TIMING_PWM_PHASE_CORRECT + 1))
+#else
+#define TIMING_PWM_HZ TIMING_PWM_HZ_MAX
+#endif
+#endif
+
+// Тактов на период ШИМ в счёте таймера: TOP + 1 в режиме Fast, TOP в режиме
+// Phase Correct, где таймер считает вверх и вниз
+#define TIMING_PWM_CYCLES                                                     \
+  (F_CPU / TIMING_PWM_HZ / (TIMING_PWM_PHASE_CORRECT + 1))
+
+// Наименьший предделитель, при котором TOP помещается в 16 бит.
+// Предделители 1, 8, 64, 256, 1024
+#if TIMING_PWM_CYCLES <= 65536UL
+#define TIMING_TIMER1_PRESCALER 1
+#define TIMING_TIMER1_CS        (1 << CS10)
+#elif TIMING_PWM_CYCLES <= 65536UL * 8
+#define TIMING_TIMER1_PRESCALER 8
+#define TIMING_TIMER1_CS        (1 << CS11)
+#elif TIMING_PWM_CYCLES <= 65536UL * 64
+#define TIMING_TIMER1_PRESCALER 64
+#define TIMING_TIMER1_CS        ((1 << CS11) | (1 << CS10))
+#elif TIMING_PWM_CYCLES <= 65536UL * 256
+#define TIMING_TIMER1_PRESCALER 256
+#define TIMING_TIMER1_CS        (1 << CS12)
+#else
+#define TIMING_TIMER1_PRESCALER 1024
+#define TIMING_TIMER1_CS        ((1 << CS12) | (1 << CS10))
+#endif
+
+#define TIMING_TIMER1_TOP                                                     \
+  (TIMING_PWM_CYCLES / TIMING_TIMER1_PRESCALER - !TIMING_PWM_PHASE_CORRECT)
+
+#if TIMING_TIMER1_TOP < 3 || TIMING_TIMER1_TOP > 65535UL
+#error "TIMING_PWM_HZ is out of range for timer 1"
+#endif
+
+// Значение OCR2 на следующий тик, вызывается из прерывания тика. Дробная
+// часть периода копится и время от времени удлиняет тик на один отсчёт,
+// поэтому в среднем тик длится ровно 1 / TIMING_TICK_HZ
+static inline u8
+timing_tick_ocr(void)
+{
+#if TIMING_TICK_FRAC
+  static u32 frac = 0;
+
+  frac += TIMING_TICK_FRAC;
+  if (frac >= TIMING_TICK_DEN) {
+    frac -= TIMING_TICK_DEN;
+    return TIMING_TIMER2_OCR + 1;
+  }
+#endif
+
+  return TIMING_TIMER2_OCR;
+}
+
+#endif
@@ -0,0 +1,120 @@
+#ifndef TREND_H
+#define TREND_H
+
+// Тренд температуры: наклон прямой наименьших квадратов по последним
+// TREND_SAMPLES отсчётам, взятым с шагом TREND_PERIOD.
+//
+// Отсчёты лежат в кольцевом буфере. Для окна с x = 0..N-1 суммы Σy и Σxy при
+// сдвиге окна обновляются за O(1): уходящий отсчёт стоит в x = 0 и в Σxy не
+// входит, остальные сдвигаются на единицу влево, то есть Σxy уменьшается на
+// их Σy. Σx и знаменатель постоянны, поэтому наклон - одно деление на
+// константу за отсчёт.
+//
+// trend_sample() принимает каждое новое значение датчика, trend_tick()
+// вызывается раз в TREND_PERIOD и кладёт в буфер последнее из них. Если за
+// шаг нового значения не было, тренд сбрасывается: окно с дырой дало бы
+// неверный наклон.
+
+#include "core.h"
+#include "temp.h"
+
+#ifndef TREND_SAMPLES
+#define TREND_SAMPLES 16
+#endif
+
+#define TREND_PERIOD SECONDS(10)
+
+// Σx = N(N-1)/2, знаменатель N * Σx² - (Σx)² = N²(N²-1)/12
+#define TREND_SUM_X (TREND_SAMPLES * (TREND_SAMPLES - 1) / 2)
+#define TREND_DEN                                                             \
+  ((i32)TREND_SAMPLES * TREND_SAMPLES * (TREND_SAMPLES * TREND_SAMPLES - 1)   \
+   / 12)
+
+// Шагов TREND_PERIOD в минуте
+#define TREND_PER_MINUTE (MINUTES(1) / TREND_PERIOD)
+
+typedef struct Trend {
+  Temp samples[TREND_SAMPLES];
+  u8   head, count;
+  i32  sum, sum_xy;
+  Temp slope; // Q12.4 за минуту
+
+  Temp latest;
+  bool fresh;
+} Trend;
+
+static Trend trend;
+
+static inline void
+trend_reset(void)
+{
+  trend.head   = 0;
+  trend.count  = 0;
+  trend.sum    = 0;
+  trend.sum_xy = 0;
+  trend.slope  = 0;
+}
+
+// Новое значение датчика
+static inline void
+trend_sample(Temp temp)
+{
+  trend.latest = temp;
+  trend.fresh  = true;
+}
+
+static inline void
+trend_push(Temp temp)
+{
+  Temp old = trend.samples[trend.head];
+  i32  num = 0;
+
+  trend.samples[trend.head] = temp;
+  trend.head                = (trend.head + 1) % TREND_SAMPLES;
+
+  if (trend.count < TREND_SAMPLES) {
+    // Окно ещё заполняется: новый отсчёт встаёт в x = count
+    trend.sum_xy += (i32)trend.count * temp;
+    trend.sum += temp;
+    trend.count += 1;
+  } else {
+    trend.sum_xy += (i32)(TREND_SAMPLES - 1) * temp - (trend.sum - old);
+    trend.sum += temp - old;
+  }
+
+  if (trend.count < TREND_SAMPLES) {
+    return;
+  }
+
+  num         = TREND_SAMPLES * trend.sum_xy - TREND_SUM_X * trend.sum;
+  trend.slope = num * (i32)TREND_PER_MINUTE / TREND_DEN;
+}
+
+// Вызывается раз в TREND_PERIOD
+static inline void
+trend_tick(void)
+{
+  if (!trend.fresh) {
+    trend_reset();
+    return;
+  }
+
+  trend.fresh = false;
+  trend_push(trend.latest);
+}
+
+// Наклон в Q12.4 за минуту, 0 пока окно не заполнено
+static inline Temp
+temp_trend(void)
+{
+  return trend.slope;
+}
+
+// Ожидаемая температура через minutes минут при текущем наклоне
+static inline Temp
+temp_forecast(Temp temp, u8 minutes)
+{
+  return temp + temp_trend() * minutes;
+}
+
+#endif
@@ -0,0 +1,152 @@
+#ifndef TUNE_H
+#define TUNE_H
+
+// Автонастройка параметров продувки релейным опытом.
+//
+// Вентилятор включается на мощности Ob, пока температура не поднимется выше
+// уставки на TUNE_RELAY, и выключается, пока она не опустится ниже уставки на
+// TUNE_RELAY. По отсчётам датчика запоминаются пики каждого полупериода и
+// длительности нагрева и остывания. Первые TUNE_SKIP циклов пропускаются,
+// пока котёл выходит на режим, по следующим TUNE_CYCLES считаются средние:
+//
+//   HI - половина размаха колебаний, чтобы циклы CP/PP не метались внутри
+//        полосы гистерезиса;
+//   PP - половина периода колебаний;
+//   CP - время, за которое вентилятор поднимает температуру на половину
+//        новой полосы HI.
+//
+// Вся арифметика целочисленная, деления - только при расчёте итога.
+
+#include "core.h"
+#include "options.h"
+#include "temp.h"
+
+// Половина ширины реле, Q12.4
+#define TUNE_RELAY (TEMP_ONE / 2)
+
+#define TUNE_SKIP   1
+#define TUNE_CYCLES 3
+
+// Полупериод дольше этого - котёл не выходит на колебания, опыт прерывается
+#define TUNE_PHASE_MAX MINUTES(90)
+
+typedef enum Tune_Phase {
+  Tune_Phase_Idle = 0,
+  Tune_Phase_Heat,  // вентилятор включён
+  Tune_Phase_Cool,  // вентилятор выключен
+  Tune_Phase_Done,  // параметры записаны
+  Tune_Phase_Failed // колебаний нет
+} Tune_Phase;
+
+typedef struct Tune {
+  Tune_Phase phase;
+  u8         cycles;   // полных циклов с начала опыта
+  Temp       min, max; // пики текущего цикла
+  u32        switched; // тик последнего переключения
+
+  // Суммы по измеряемым циклам
+  u32 heat_ms, cool_ms;
+  u32 swing; // размах, Q12.4
+} Tune;
+
+static inline void
+tune_start(Tune *self, u32 now_ticks)
+{
+  *self = (Tune){
+    .phase    = Tune_Phase_Heat,
+    .min      = INT16_MAX,
+    .switched = now_ticks,
+  };
+}
+
+static inline bool
+tune_running(const Tune *self)
+{
+  return self->phase == Tune_Phase_Heat || self->phase == Tune_Phase_Cool;
+}
+
+// Итог опыта: рекомендованные HI, PP и CP записываются в options
+static inline void
+tune_apply(const Tune *self)
+{
+  u32 swing = self->swing ? self->swing : 1;
+  u32 half  = swing / (2 * TUNE_CYCLES);
+  u32 cycle = (self->heat_ms + self->cool_ms) / TUNE_CYCLES;
+  u32 cp_ms = 0;
+
+  option_set(Option_hysteresis,
+             temp_to_int((Temp)CLAMP_TOP(half, INT16_MAX)));
+  option_set(Option_fan_pause_duration,
+             (i16)CLAMP_TOP((cycle / 2 + MINUTES(1) / 2) / MINUTES(1), 99));
+
+  // Скорость нагрева - размах за время нагрева
+  cp_ms = (u32)TEMP(options.hysteresis) * self->heat_ms / (2 * swing);
+  option_set(Option_fan_work_duration,
+             (i16)CLAMP_TOP((cp_ms + SECONDS(1) / 2) / SECONDS(1), 99));
+}
+
+// Новый отсчёт температуры. Возвращает, должен ли работать вентилятор
+static inline bool
+tune_update(Tune *self, Temp temp, Temp target, u32 now_ticks)
+{
+  u32  elapsed  = now_ticks - self->switched;
+  bool measured = self->cycles >= TUNE_SKIP;
+
+  if (!tune_running(self)) {
+    return false;
+  }
+
+  if (elapsed > TUNE_PHASE_MAX) {
+    self->phase = Tune_Phase_Failed;
+    return false;
+  }
+
+  if (temp < self->min) {
+    self->min = temp;
+  }
+  if (temp > self->max) {
+    self->max = temp;
+  }
+
+  if (self->phase == Tune_Phase_Heat) {
+    if (temp < target + TUNE_RELAY) {
+      return true;
+    }
+
+    if (measured) {
+      self->heat_ms += elapsed;
+    }
+
+    // Пик ещё впереди: котёл продолжает нагреваться после выключения
+    self->phase    = Tune_Phase_Cool;
+    self->switched = now_ticks;
+    self->max      = temp;
+    return false;
+  }
+
+  if (temp > target - TUNE_RELAY) {
+    return false;
+  }
+
+  // Цикл закончен: минимум - в начале нагрева, максимум - в начале остывания
+  if (measured) {
+    self->cool_ms += elapsed;
+    self->swing += self->max - self->min;
+  }
+
+  self->cycles += 1;
+
+  self->phase    = Tune_Phase_Heat;
+  self->switched = now_ticks;
+  self->min      = temp;
+
+  if (self->cycles >= TUNE_SKIP + TUNE_CYCLES) {
+    tune_apply(self);
+    self->phase = Tune_Phase_Done;
+    return false;
+  }
+
+  return true;
+}
+
+#endif